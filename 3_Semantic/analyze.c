@@ -38,9 +38,20 @@ static void traverse( TreeNode * t,
   }
 }
 
+/* Function builtinParam makes a parameter
+ * of a builtin function
+ */
+static TreeNode * builtinParam(ParamKind kind, char * name, ExpType type)
+{ TreeNode *param = newParamNode(kind);
+  param->attr.name = name;
+  param->type = type;
+  return param;
+}
+
 /* Procedure insertBuiltinFunc inserts 
  * Builtin functions such as input and output 
- * into the symbol table 
+ * into the symbol table; memcpy and memset
+ * are the TM block instructions MCPY and MSET
  */
 static void insertBuiltinFunc(void)
 { TreeNode *func;
@@ -80,6 +91,42 @@ static void insertBuiltinFunc(void)
   func->child[1] = compStmt;
   
   st_insert("output", -1, location, func);
+
+  /* void memcpy(int dst[], int src[], int n) */
+  param = builtinParam(ArrParamK,"dst",IntegerArray);
+  param->sibling = builtinParam(ArrParamK,"src",IntegerArray);
+  param->sibling->sibling = builtinParam(SingleParamK,"n",Integer);
+
+  compStmt = newStmtNode(CompK);
+  compStmt->child[0] = NULL; // No local variables
+  compStmt->child[1] = NULL; // No stmt
+
+  func = newDeclNode(FunK);
+  func->lineno = 0;
+  func->attr.name = "memcpy";
+  func->type = Void;
+  func->child[0] = param;
+  func->child[1] = compStmt;
+
+  st_insert("memcpy", -1, location, func);
+
+  /* void memset(int dst[], int value, int n) */
+  param = builtinParam(ArrParamK,"dst",IntegerArray);
+  param->sibling = builtinParam(SingleParamK,"value",Integer);
+  param->sibling->sibling = builtinParam(SingleParamK,"n",Integer);
+
+  compStmt = newStmtNode(CompK);
+  compStmt->child[0] = NULL; // No local variables
+  compStmt->child[1] = NULL; // No stmt
+
+  func = newDeclNode(FunK);
+  func->lineno = 0;
+  func->attr.name = "memset";
+  func->type = Void;
+  func->child[0] = param;
+  func->child[1] = compStmt;
+
+  st_insert("memset", -1, location, func);
 }
 
 /* nullProc is a do-nothing procedure to 
@@ -0,0 +1,72 @@
+#!/bin/sh
+# bench.sh: compare the switch, threaded and jit TM engines
+# usage: bench/bench.sh [program.tm]   (run from 3_Semantic)
+
+TM=${TM:-./tm}
+PGM=${1:-bench/loop.tm}
+
+for E in switch threaded jit; do
+  printf 'p\ng\nq\n' | $TM -e $E $PGM | grep -E 'Number|Execution|Dispatches'
+done
+
+# per-run cost of an embedded run (TM library) against
+# spawning a tm process, on a short program
+if [ -x ./tmbench ]; then
+  ./tmbench -i bench/fact.in bench/fact.tm
+fi
+
+# multi-input runs (-m) with 1 thread and one per processor
+SETS=/tmp/tmbench.sets.$$
+awk 'BEGIN { for (i = 0; i < 200000; i++) print i % 13 }' > $SETS
+for J in 1 `getconf _NPROCESSORS_ONLN`; do
+  START=`date +%s%N`
+  $TM -m $SETS -j $J bench/fact.tm > /dev/null
+  echo "-m, $J thread(s): $(( (`date +%s%N` - START) / 1000000 )) ms"
+done
+rm -f $SETS
+
+# a long setup before the first IN (bench/sweep.tm): it is run
+# once, then each run starts from a snapshot (threads) or a
+# forked copy of the process (-k)
+SETS=/tmp/tmbench.sets.$$
+awk 'BEGIN { for (i = 0; i < 2000; i++) print i % 1000 }' > $SETS
+for K in "" -k; do
+  START=`date +%s%N`
+  $TM -m $SETS -j 1 $K bench/sweep.tm > /dev/null
+  echo "-m sweep.tm $K: $(( (`date +%s%N` - START) / 1000000 )) ms"
+done
+rm -f $SETS
+
+# a generated program too large for the caches, 240000
+# locations of cgen-like code run 200 times; TMOLD, another
+# tm (an earlier build, say), is run on it for comparison
+# (bench/layout.txt has the numbers for the decoded layouts)
+BIG=/tmp/tmbench.big.$$.tm
+awk 'BEGIN { n = 0
+  print n++ ": LDC 1,200(0)"
+  for (i = 0; i < 40000; i++) {
+    k = i % 500
+    print n++ ": LD 0," k "(5)"
+    print n++ ": ST 0,0(6)"
+    print n++ ": LDC 0," i "(0)"
+    print n++ ": LD 2,0(6)"
+    print n++ ": ADD 0,2,0"
+    print n++ ": ST 0," k "(5)"
+  }
+  print n++ ": LDA 1,-1(1)"
+  print n++ ": JNE 1,1(4)"
+  print n++ ": HALT 0,0,0" }' > $BIG
+for T in $TM $TMOLD; do
+  for E in switch threaded; do
+    echo "$T $E, `printf 'p\ng\nq\n' | $T -e $E $BIG | grep Execution`"
+  done
+done
+rm -f $BIG
+
+# ahead-of-time translation to C (-x prog.c)
+if $TM -x /tmp/tmbench.$$.c $PGM && cc -O2 -fwrapv -o /tmp/tmbench.$$ /tmp/tmbench.$$.c; then
+  START=`date +%s%N`
+  /tmp/tmbench.$$ < /dev/null > /dev/null
+  echo "tm2c: $(( (`date +%s%N` - START) / 1000000 )) ms"
+  rm -f /tmp/tmbench.$$ /tmp/tmbench.$$.c
+fi
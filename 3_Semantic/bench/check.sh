@@ -0,0 +1,47 @@
+#!/bin/sh
+# check.sh: run the regression programs on every engine,
+# and translated to C, against the output on their
+# "* expect:" line
+# usage: bench/check.sh   (run from 3_Semantic)
+
+TM=${TM:-./tm}
+STATUS=0
+C=/tmp/tmcheck.$$
+
+for P in bench/ldpc.tm bench/wrap.tm bench/div.tm bench/cmp.tm bench/leave.tm bench/ret.tm \
+         bench/vmax.tm; do
+  WANT=`sed -n 's/^\* expect: //p' $P`
+  for E in switch threaded jit tm2c; do
+    if [ $E = tm2c ]; then
+      $TM -x $C.c $P && cc -O2 -fwrapv -o $C $C.c || { STATUS=1; continue; }
+      GOT=`$C < /dev/null | tr '\n' ' '`
+    else
+      GOT=`$TM -b -e $E $P < /dev/null | tr '\n' ' '`
+    fi
+    GOT=`echo $GOT`
+    if [ "$GOT" != "$WANT" ]; then
+      echo "$P, $E: got '$GOT', expected '$WANT'"
+      STATUS=1
+    fi
+  done
+done
+# -m and -m -k against -b under a step limit just
+# past the setup before the first IN that the runs
+# of -m share: the setup counts towards the limit
+echo 5 > $C.in
+for L in 1506505 1506510; do
+  for E in switch threaded jit; do
+    WANT=`$TM -b -e $E -l $L bench/sweep.tm < $C.in 2>&1 | tr '\n' ' '`
+    WANT=`echo $WANT`
+    for K in "" -k; do
+      GOT=`$TM -m $C.in $K -e $E -l $L bench/sweep.tm | sed 's/# //'`
+      if [ "$GOT" != "$WANT" ]; then
+        echo "bench/sweep.tm, -m $K -l $L, $E: got '$GOT', expected '$WANT'"
+        STATUS=1
+      fi
+    done
+  done
+done
+rm -f $C $C.c $C.in
+[ $STATUS = 0 ] && echo "all regression programs pass"
+exit $STATUS
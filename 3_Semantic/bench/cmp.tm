@@ -0,0 +1,35 @@
+* regression: the comparisons the compiler emits
+* now, which the threaded engine fuses, test the
+* wrapped difference on every engine: the value
+* form the peephole pass leaves, and the SUB and
+* branch of an if or while
+* expect: 0 1 7 9
+  0:    LDC  1,-2147483647(0)
+  1:    LDA  1,-1(1)     INT_MIN
+  2:    LDC  3,1(0)
+  3:    SUB  3,1,3       INT_MIN < 1: INT_MAX, false
+  4:    LDC  1,1(0)
+  5:    JLT  3,1(7)
+  6:    LDC  1,0(0)
+  7:    OUT  1,0,0
+  8:    LDC  2,1(0)
+  9:    LDC  3,2(0)
+ 10:    SUB  3,2,3       1 < 2: true
+ 11:    LDC  2,1(0)
+ 12:    JLT  3,1(7)
+ 13:    LDC  2,0(0)
+ 14:    OUT  2,0,0
+ 15:    LDC  1,-2147483647(0)
+ 16:    LDA  1,-1(1)
+ 17:    LDC  2,1(0)
+ 18:    SUB  1,1,2       INT_MIN - 1 wraps to INT_MAX
+ 19:    JLT  1,2(7)      not taken
+ 20:    LDC  4,7(0)
+ 21:    OUT  4,0,0
+ 22:    SUB  1,1,2
+ 23:    JGT  1,2(7)      taken
+ 24:    LDC  4,8(0)
+ 25:    OUT  4,0,0
+ 26:    LDC  4,9(0)
+ 27:    OUT  4,0,0
+ 28:   HALT  0,0,0
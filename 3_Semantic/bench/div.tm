@@ -0,0 +1,23 @@
+* regression: the least int divided by -1 wraps
+* around to itself on every engine, instead of
+* trapping in the host; other quotients truncate.
+* The loop runs often enough for the jit to
+* compile it
+* expect: -2147483648 -3 2147483647
+  0:    LDC  1,-2147483647(0)
+  1:    LDA  1,-1(1)     INT_MIN
+  2:    LDC  2,-1(0)
+  3:    LDC  5,20(0)     iterations
+  4:    LDC  6,1(0)
+  5:    DIV  0,1,2       INT_MIN / -1 wraps to INT_MIN
+  6:    LDC  3,-7(0)
+  7:    LDC  4,2(0)
+  8:    DIV  3,3,4
+  9:    SUB  5,5,6
+ 10:    JGT  5,-6(7)
+ 11:    OUT  0,0,0
+ 12:    OUT  3,0,0
+ 13:    LDC  1,-2147483647(0)
+ 14:    DIV  0,1,2       INT_MAX
+ 15:    OUT  0,0,0
+ 16:   HALT  0,0,0
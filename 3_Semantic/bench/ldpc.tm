@@ -0,0 +1,11 @@
+* regression: a load into the pc from a verified
+* address is a jump on every engine
+* expect: 7
+  0:    LDC  1,5(0)
+  1:     ST  1,5(0)
+  2:    LDC  1,0(0)
+  3:     LD  7,5(1)      jump to dMem[5] = 5
+  4:    OUT  1,0,0       skipped
+  5:    LDC  1,7(0)
+  6:    OUT  1,0,0
+  7:   HALT  0,0,0
@@ -0,0 +1,20 @@
+* regression: a jump the verifier cannot follow
+* (9, to 10 or 11) lands at 10 with mp far
+* outside dMem. The verifier gave 10 the state of
+* the call whose return address it is, at 1, so
+* every engine must see the state is not covered
+* and check the LD there, which faults
+* expect: 5
+  0:     LD  6,0(0)
+  1:    LDA  1,8(7)      return address: 10
+  2:     ST  1,0(6)
+  3:    LDC  2,5(0)
+  4:    OUT  2,0,0
+  5:    LDC  2,10(0)
+  6:    JEQ  0,1(7)      always taken
+  7:    LDC  2,11(0)
+  8:    LDC  6,100000(0) mp outside dMem
+  9:    LDA  7,0(2)
+ 10:     LD  3,0(6)      faults
+ 11:    OUT  3,0,0
+ 12:   HALT  0,0,0
@@ -0,0 +1,43 @@
+* TM benchmark: s = (s + i*3) / 2 for i = 5000000 .. 1
+* laid out the way cgen.c emits expressions and tests
+  0:     LD  6,0(0)      load maxaddress from location 0
+  1:     ST  0,0(0)      clear location 0
+  2:    LDC  0,5000000(0)
+  3:     ST  0,0(5)      i = 5000000
+  4:    LDC  0,0(0)
+  5:     ST  0,1(5)      s = 0
+* loop body
+  6:     LD  0,1(5)      load s
+  7:     ST  0,0(6)      op: push left
+  8:     LD  0,0(5)      load i
+  9:     ST  0,-1(6)     op: push left
+ 10:    LDC  0,3(0)
+ 11:     LD  1,-1(6)     op: load left
+ 12:    MUL  0,1,0
+ 13:     LD  1,0(6)      op: load left
+ 14:    ADD  0,1,0
+ 15:     ST  0,0(6)      op: push left
+ 16:    LDC  0,2(0)
+ 17:     LD  1,0(6)      op: load left
+ 18:    DIV  0,1,0
+ 19:     ST  0,1(5)      s = ...
+ 20:     LD  0,0(5)      load i
+ 21:     ST  0,0(6)      op: push left
+ 22:    LDC  0,1(0)
+ 23:     LD  1,0(6)      op: load left
+ 24:    SUB  0,1,0
+ 25:     ST  0,0(5)      i = i - 1
+* until i == 0
+ 26:     LD  0,0(5)
+ 27:     ST  0,0(6)      op: push left
+ 28:    LDC  0,0(0)
+ 29:     LD  1,0(6)      op: load left
+ 30:    SUB  0,1,0      op ==
+ 31:    JEQ  0,2(7)      br if true
+ 32:    LDC  0,0(0)      false case
+ 33:    LDA  7,1(7)      unconditional jmp
+ 34:    LDC  0,1(0)      true case
+ 35:    JEQ  0,-30(7)    repeat: jmp back to body
+ 36:     LD  0,1(5)
+ 37:    OUT  0,0,0
+ 38:   HALT  0,0,0
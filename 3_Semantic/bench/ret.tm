@@ -0,0 +1,20 @@
+* regression: the return at 9 (LD pc) runs 40
+* times, so the jit compiles it and 10, and the
+* last time lands at 10 with mp far outside dMem.
+* The verifier gave 10 the state of the call at
+* 4, so every engine must see the state is not
+* covered and check the LD there, which faults
+* expect: 40
+  0:     LD  6,0(0)
+  1:    LDC  4,40(0)
+  2:    OUT  4,0,0
+  3:    LDA  2,0(6)
+  4:    LDA  1,5(7)      return address: 10
+  5:     ST  1,0(6)
+  6:    LDA  4,-1(4)
+  7:    JNE  4,1(7)      to 9 but the last time
+  8:    LDC  6,100000(0) mp outside dMem
+  9:     LD  7,0(2)      return
+ 10:     LD  3,0(6)      faults the last time
+ 11:    JNE  4,-9(7)     to 3
+ 12:   HALT  0,0,0
@@ -0,0 +1,23 @@
+* TM benchmark for -m: a long setup before the first IN
+* (dMem[i] = 1+2+...+i for i = 1..1000), then one lookup
+* of dMem[x mod 1000] per input value x
+  0:     LD  6,0(0)      load maxaddress from location 0
+  1:     ST  0,0(0)      clear location 0
+  2:    LDC  1,1000(0)   i = 1000
+  3:    LDC  2,0(0)      s = 0
+  4:    LDA  4,0(1)      j = i
+  5:    ADD  2,2,4       s = s + j
+  6:    LDA  4,-1(4)     j = j - 1
+  7:    JGT  4,-3(7)     until j == 0
+  8:     ST  2,0(1)      dMem[i] = s
+  9:    LDA  1,-1(1)     i = i - 1
+ 10:    JGT  1,-8(7)     until i == 0
+ 11:    OUT  2,0,0       dMem[1]
+ 12:     IN  0,0,0       x
+ 13:    LDC  3,1000(0)
+ 14:    DIV  2,0,3
+ 15:    MUL  2,2,3
+ 16:    SUB  0,0,2       x mod 1000
+ 17:     LD  1,0(0)
+ 18:    OUT  1,0,0       dMem[x mod 1000]
+ 19:   HALT  0,0,0
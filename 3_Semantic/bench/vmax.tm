@@ -0,0 +1,59 @@
+* regression: VMIN and VMAX go through the words
+* from the x in their first register on, a word
+* becoming the new x when its wrapped difference
+* from x is below (above) 0, as in the loops
+* expect: 2 2 1 1 5 -1
+  0:    LDC  4,2147483647(0)
+  1:     ST  4,10(0)
+  2:    LDC  4,-5(0)
+  3:     ST  4,11(0)
+  4:    LDC  4,9(0)
+  5:     ST  4,12(0)       11 to 18 stay 0
+  6:    LDC  2,10(0)
+  7:    LDC  3,4(0)
+  8:    LDC  1,0(0)
+  9:   VMAX  1,2,3         2: 9 is after INT_MAX as the loop goes
+ 10:    OUT  1,0,0
+ 11:    LDC  3,9(0)
+ 12:    LDC  1,0(0)
+ 13:   VMAX  1,2,3         the same over the lanes
+ 14:    OUT  1,0,0
+ 15:    LDC  4,1500000000(0)
+ 16:     ST  4,30(0)
+ 17:    LDC  4,-1500000000(0)
+ 18:     ST  4,31(0)
+ 19:    LDC  2,30(0)
+ 20:    LDC  3,2(0)
+ 21:    LDC  1,0(0)
+ 22:   VMAX  1,2,3         1, though less than the x it started at
+ 23:    OUT  1,0,0
+ 24:    LDC  4,3(0)
+ 25:     ST  4,20(0)
+ 26:    LDC  4,1(0)
+ 27:     ST  4,21(0)
+ 28:    LDC  4,4(0)
+ 29:     ST  4,22(0)
+ 30:    LDC  4,1(0)
+ 31:     ST  4,23(0)
+ 32:    LDC  4,5(0)
+ 33:     ST  4,24(0)
+ 34:    LDC  4,9(0)
+ 35:     ST  4,25(0)
+ 36:    LDC  4,2(0)
+ 37:     ST  4,26(0)
+ 38:    LDC  4,6(0)
+ 39:     ST  4,27(0)
+ 40:    LDC  4,5(0)
+ 41:     ST  4,28(0)
+ 42:    LDC  2,20(0)
+ 43:    LDC  3,9(0)
+ 44:    LDC  1,2(0)
+ 45:   VMIN  1,2,3         the first 1
+ 46:    OUT  1,0,0
+ 47:    LDC  1,0(0)
+ 48:   VMAX  1,2,3         9
+ 49:    OUT  1,0,0
+ 50:    LDC  1,1(0)
+ 51:   VMIN  1,2,3         none below 1
+ 52:    OUT  1,0,0
+ 53:   HALT  0,0,0
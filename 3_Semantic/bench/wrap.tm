@@ -0,0 +1,18 @@
+* regression: ADD, SUB and MUL wrap around on every
+* engine, and so does the difference of a fused
+* comparison: INT_MIN < 1 is false once SUB wraps
+* expect: -2147483648 0 0
+  0:    LDC  1,2147483647(0)
+  1:    LDC  2,1(0)
+  2:    ADD  1,1,2       INT_MIN
+  3:    OUT  1,0,0
+  4:    SUB  1,1,2       INT_MIN - 1 wraps to INT_MAX
+  5:    JLT  1,2(7)
+  6:    LDC  1,0(0)
+  7:    LDA  7,1(7)
+  8:    LDC  1,1(0)
+  9:    OUT  1,0,0
+ 10:    LDC  3,65536(0)
+ 11:    MUL  3,3,3       2^32 wraps to 0
+ 12:    OUT  3,0,0
+ 13:   HALT  0,0,0
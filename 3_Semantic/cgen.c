@@ -1,186 +1,690 @@
 /****************************************************/
 /* File: cgen.c                                     */
 /* The code generator implementation                */
-/* for the TINY compiler                            */
+/* for the C-MINUS compiler                         */
 /* (generates code for the TM machine)              */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
 
 #include "globals.h"
-#include "symtab.h"
 #include "code.h"
 #include "cgen.h"
 
-/* tmpOffset is the memory offset for temps
-   It is decremented each time a temp is
-   stored, and incremeted when loaded again
-*/
-static int tmpOffset = 0;
+/* Run-time layout. Globals are at gp+0 upward (gp
+ * is 0). A call pushes the arguments, left to
+ * right, and the return address on the mp stack;
+ * the callee then takes the words of its locals,
+ * for all of its blocks at once:
+ *
+ *   arg 1 .. arg n, return address, locals
+ *
+ * There is no frame pointer: a local or parameter
+ * is addressed from mp, at its offset in the frame
+ * plus the words pushed since the locals were
+ * taken (depth), which is known wherever code is
+ * emitted. A function returns its value in ac. An
+ * array is passed as the address of its first
+ * element.
+ *
+ * Expression temporaries are a stack whose top
+ * three entries live in registers 2..4. When a
+ * fourth is needed, the lowest one in a register
+ * is pushed on the mp stack (spilled), and it is
+ * popped back when it is next used. Before a call
+ * all of them are pushed, since the callee uses
+ * the registers too.
+ */
+
+/* registers of the temporaries */
+#define FIRSTTEMP 2
+#define NTEMPS    3
+#define TEMPREG(j) (FIRSTTEMP + (j) % NTEMPS)
+
+/* where a name lives */
+typedef enum { GlobalV, FrameV, RefV, FunV } VarKind;
+
+/* A name in scope: a variable at offset from gp
+ * (GlobalV) or from mp at depth 0 (FrameV), an
+ * array parameter whose frame word holds the
+ * address of the array (RefV), or a function
+ * whose code is at label offset (FunV)
+ */
+typedef struct
+   { char * name;
+     VarKind kind;
+     int offset;
+     int array; /* the words of an array, not an int */
+   } VarRec;
+
+/* the names in scope, innermost last */
+static VarRec * vars = NULL;
+static int nvars = 0;
+static int varsSize = 0;
+
+/* next free global location */
+static int globalNext = 0;
+
+/* the label of main, which the prelude calls */
+static int mainLabel;
+
+/* the function being generated: its name, the
+ * words of its locals, the next free one, and
+ * the words pushed since they were taken */
+static char * funcName = NULL;
+static int frameSize = 0;
+static int frameNext = 0;
+static int depth = 0;
+
+/* nTemps is the number of live temporaries, of
+ * which the first spilled are on the stack */
+static int nTemps = 0;
+static int spilled = 0;
 
 /* prototype for internal recursive code generator */
 static void cGen (TreeNode * tree);
+static void genExp( TreeNode * tree);
+
+/* Procedure bind puts a name in scope */
+static void bind( char * name, VarKind kind, int offset, int array)
+{ if (nvars == varsSize)
+  { varsSize = varsSize ? 2 * varsSize : 64;
+    vars = (VarRec *) realloc(vars,varsSize * sizeof(VarRec));
+    if (vars == NULL)
+    { fprintf(listing,"Out of memory for the code generator\n");
+      exit(1);
+    }
+  }
+  vars[nvars].name = name;
+  vars[nvars].kind = kind;
+  vars[nvars].offset = offset;
+  vars[nvars++].array = array;
+}
+
+/* Function lookup finds the innermost name in
+ * scope; the type checker has seen to it that
+ * there is one
+ */
+static VarRec * lookup( char * name)
+{ int i;
+  for (i = nvars - 1; i >= 0; i--)
+    if (strcmp(vars[i].name,name) == 0) return &vars[i];
+  emitComment("BUG: unknown name in lookup");
+  bind(name,GlobalV,0,FALSE);
+  return &vars[nvars-1];
+}
+
+/* base register and displacement of a variable */
+static int varBase( VarRec * v)
+{ return v->kind == GlobalV ? gp : mp; }
+
+static int varDisp( VarRec * v)
+{ return v->kind == GlobalV ? v->offset : v->offset + depth; }
+
+/* Procedure push (pop) emits a push (pop) of
+ * register r, keeping track of the depth
+ */
+static void push( int r, char * c)
+{ emitPush(r,c);
+  depth++;
+}
+
+static void pop( int r, char * c)
+{ emitPop(r,c);
+  depth--;
+}
+
+/* Function newTemp allocates a temporary on top,
+ * spilling the lowest one in a register if all
+ * are taken; it gives the register
+ */
+static int newTemp(void)
+{ if (nTemps - spilled == NTEMPS)
+  { push(TEMPREG(spilled),"spill temp");
+    spilled++;
+  }
+  return TEMPREG(nTemps++);
+}
+
+/* Procedure freeTemp frees the top temporary */
+static void freeTemp(void)
+{ nTemps--; }
+
+/* Procedure loadTemps gets the top n (at most
+ * NTEMPS) temporaries back into their registers
+ */
+static void loadTemps( int n)
+{ while (spilled > nTemps - n)
+  { spilled--;
+    pop(TEMPREG(spilled),"reload temp");
+  }
+}
+
+/* Procedure saveTemps spills every temporary */
+static void saveTemps(void)
+{ while (spilled < nTemps)
+  { push(TEMPREG(spilled),"save temp");
+    spilled++;
+  }
+}
+
+/* Function temp gives the register of the n-th
+ * temporary from the top (0 is the top)
+ */
+static int temp( int n)
+{ return TEMPREG(nTemps - 1 - n); }
+
+/* Procedure arrayBase loads the address of the
+ * first element of array v into register r
+ */
+static void arrayBase( VarRec * v, int r)
+{ if (v->kind == RefV)
+    emitRM("LD",r,varDisp(v),mp,"load array address");
+  else
+    emitRM("LDA",r,varDisp(v),varBase(v),"array address");
+}
+
+/* Function elemDisp makes register r, holding an
+ * index into array v, the base register for the
+ * element; it gives the displacement
+ */
+static int elemDisp( VarRec * v, int r)
+{ if (v->kind == RefV)
+  { emitRM("LD",ac1,varDisp(v),mp,"load array address");
+    emitRO("ADD",r,r,ac1,"element address");
+    return 0;
+  }
+  emitRO("ADD",r,r,varBase(v),"element base");
+  return varDisp(v);
+}
+
+/* Function declSize gives the words of a
+ * variable declaration
+ */
+static int declSize( TreeNode * d)
+{ return d->kind.decl == VarArrK ? d->attr.array.size : 1; }
+
+/* Function localSize gives the words the locals
+ * of the statements t need; blocks one after the
+ * other share them
+ */
+static int localSize( TreeNode * t)
+{ TreeNode * d;
+  int size, other, max = 0;
+  for (; t != NULL; t = t->sibling)
+  { size = 0;
+    if (t->nodekind == StmtK)
+      switch (t->kind.stmt)
+      { case CompK:
+          for (d = t->child[0]; d != NULL; d = d->sibling)
+            size += declSize(d);
+          size += localSize(t->child[1]);
+          break;
+        case SelK:
+          size = localSize(t->child[1]);
+          other = localSize(t->child[2]);
+          if (other > size) size = other;
+          break;
+        case IterK:
+          size = localSize(t->child[1]);
+          break;
+        default:
+          break;
+      }
+    if (size > max) max = size;
+  }
+  return max;
+}
+
+/* Procedure genCall generates code for a call,
+ * leaving the result in a new temporary if value
+ */
+static void genCall( TreeNode * tree, int value)
+{ TreeNode * arg = tree->child[0];
+  char * name = tree->attr.name;
+  VarRec * f;
+  int nargs = 0;
+  if (strcmp(name,"input") == 0)
+  { emitRO("IN",newTemp(),0,0,"input");
+    if (! value) freeTemp();
+  }
+  else if (strcmp(name,"output") == 0)
+  { genExp(arg);
+    loadTemps(1);
+    emitRO("OUT",temp(0),0,0,"output");
+    freeTemp();
+  }
+  else if ((strcmp(name,"memcpy") == 0) || (strcmp(name,"memset") == 0))
+  { for (; arg != NULL; arg = arg->sibling) genExp(arg);
+    loadTemps(3);
+    emitRO(name[3] == 'c' ? "MCPY" : "MSET",temp(2),temp(1),temp(0),name);
+    freeTemp();
+    freeTemp();
+    freeTemp();
+  }
+  else
+  { if (TraceCode) emitComment("-> call") ;
+    f = lookup(name);
+    saveTemps();
+    for (; arg != NULL; arg = arg->sibling)
+    { genExp(arg);
+      loadTemps(1);
+      push(temp(0),"push argument");
+      freeTemp();
+      nargs++;
+    }
+    emitCall(f->offset,name);
+    if (nargs > 0)
+    { emitRM("LDA",mp,nargs,mp,"pop arguments");
+      depth -= nargs;
+    }
+    if (value) emitRM("LDA",newTemp(),0,ac,"call result");
+    if (TraceCode) emitComment("<- call") ;
+  }
+} /* genCall */
+
+/* Procedure genAssign generates code for an
+ * assignment, leaving its value in a new
+ * temporary
+ */
+static void genAssign( TreeNode * tree)
+{ TreeNode * lhs = tree->child[0];
+  VarRec * v = lookup(lhs->attr.name);
+  int r;
+  if (TraceCode) emitComment("-> assign") ;
+  genExp(tree->child[1]);
+  if (lhs->kind.exp == IdArrK)
+  { genExp(lhs->child[0]);
+    loadTemps(2);
+    r = temp(0);
+    emitRM("ST",temp(1),elemDisp(v,r),r,"assign: store element");
+    freeTemp();
+  }
+  else
+  { loadTemps(1);
+    emitRM("ST",temp(0),varDisp(v),varBase(v),"assign: store value");
+  }
+  if (TraceCode) emitComment("<- assign") ;
+} /* genAssign */
+
+/* Function branchOp gives the jump on the
+ * difference of the operands of relational
+ * operator op taken when op holds, or when it
+ * does not if holds is FALSE
+ */
+static char * branchOp( TokenType op, int holds)
+{ switch (op)
+  { case LT : return holds ? "JLT" : "JGE";
+    case LE : return holds ? "JLE" : "JGT";
+    case GT : return holds ? "JGT" : "JLE";
+    case GE : return holds ? "JGE" : "JLT";
+    case EQ : return holds ? "JEQ" : "JNE";
+    default : return holds ? "JNE" : "JEQ";
+  }
+} /* branchOp */
+
+/* Procedure genExp generates code at an expression
+ * node, leaving its value in a new temporary
+ */
+static void genExp( TreeNode * tree)
+{ VarRec * v;
+  int r, s, trueLabel, endLabel;
+  switch (tree->kind.exp) {
+
+    case ConstK :
+      emitRM("LDC",newTemp(),tree->attr.val,0,"load const");
+      break; /* ConstK */
+
+    case IdK :
+      v = lookup(tree->attr.name);
+      /* a spill moves mp: take the temporary first */
+      r = newTemp();
+      if (v->array || (v->kind == RefV))
+        arrayBase(v,r);
+      else
+        emitRM("LD",r,varDisp(v),varBase(v),"load id value");
+      break; /* IdK */
+
+    case IdArrK :
+      v = lookup(tree->attr.name);
+      genExp(tree->child[0]);
+      loadTemps(1);
+      r = temp(0);
+      emitRM("LD",r,elemDisp(v,r),r,"load element");
+      break; /* IdArrK */
+
+    case AssignK :
+      genAssign(tree);
+      break; /* AssignK */
+
+    case CallK :
+      genCall(tree,TRUE);
+      break; /* CallK */
+
+    case OpK :
+    case RelopK :
+      if (TraceCode) emitComment("-> Op") ;
+      genExp(tree->child[0]);
+      genExp(tree->child[1]);
+      loadTemps(2);
+      r = temp(1);
+      s = temp(0);
+      switch (tree->attr.op) {
+        case PLUS :
+          emitRO("ADD",r,r,s,"op +");
+          break;
+        case MINUS :
+          emitRO("SUB",r,r,s,"op -");
+          break;
+        case TIMES :
+          emitRO("MUL",r,r,s,"op *");
+          break;
+        case OVER :
+          emitRO("DIV",r,r,s,"op /");
+          break;
+        case LT :
+        case LE :
+        case GT :
+        case GE :
+        case EQ :
+        case NE :
+          trueLabel = emitNewLabel();
+          endLabel = emitNewLabel();
+          emitRO("SUB",r,r,s,"op compare") ;
+          emitRM_Label(branchOp(tree->attr.op,TRUE),r,trueLabel,
+                       "br if true") ;
+          emitRM("LDC",r,0,0,"false case") ;
+          emitRM_Label("LDA",pc,endLabel,"unconditional jmp") ;
+          emitLabel(trueLabel);
+          emitRM("LDC",r,1,0,"true case") ;
+          emitLabel(endLabel);
+          break;
+        default:
+          emitComment("BUG: Unknown operator");
+          break;
+      } /* case op */
+      freeTemp();
+      if (TraceCode)  emitComment("<- Op") ;
+      break; /* OpK */
+
+    default:
+      break;
+  }
+} /* genExp */
+
+/* Procedure genCond generates code for the test
+ * of an if or while: a jump to falseLabel if
+ * tree is 0. A relational operator is not made
+ * 0 or 1 first, but jumps on the difference.
+ * c = a comment for the jump
+ */
+static void genCond( TreeNode * tree, int falseLabel, char * c)
+{ int r, s;
+  if ((tree->nodekind != ExpK) || (tree->kind.exp != RelopK))
+  { genExp(tree);
+    loadTemps(1);
+    r = temp(0);
+    freeTemp();
+    emitRM_Label("JEQ",r,falseLabel,c);
+    return;
+  }
+  if (TraceCode) emitComment("-> Op") ;
+  genExp(tree->child[0]);
+  genExp(tree->child[1]);
+  loadTemps(2);
+  r = temp(1);
+  s = temp(0);
+  freeTemp();
+  freeTemp();
+  emitRO("SUB",r,r,s,"op compare") ;
+  emitRM_Label(branchOp(tree->attr.op,FALSE),r,falseLabel,c);
+  if (TraceCode)  emitComment("<- Op") ;
+} /* genCond */
+
+/* Procedure genVec generates code for a VecK
+ * node (see vectorize.c): one TM block or vector
+ * instruction on the n-i words from a[i]
+ */
+static void genVec( TreeNode * tree)
+{ TreeNode * cond = tree->child[0];
+  VarRec * i = lookup(cond->child[0]->attr.name);
+  VarRec * a = lookup(tree->child[1]->attr.name);
+  TreeNode * b = tree->child[2];
+  VarRec * x;
+  int r, rn, ri, rb, endLabel, skipLabel;
+  if (TraceCode) emitComment("-> vector loop") ;
+  genExp(cond->child[1]);
+  r = newTemp();
+  emitRM("LD",r,varDisp(i),varBase(i),"vector: load index");
+  loadTemps(2);
+  rn = temp(1);
+  ri = temp(0);
+  emitRO("SUB",rn,rn,ri,"vector: count");
+  endLabel = emitNewLabel();
+  emitRM_Label("JLE",rn,endLabel,"vector: skip if none");
+  emitRO("ADD",ac,ri,rn,"vector: index at end");
+  emitRM("ST",ac,varDisp(i),varBase(i),"vector: store index");
+  switch (tree->attr.vec) {
+    case VecCopyK :
+    case VecAddK :
+    case VecMulK :
+      rb = newTemp();
+      arrayBase(lookup(b->attr.name),ac1);
+      emitRO("ADD",rb,ri,ac1,"vector: source address");
+      arrayBase(a,ac1);
+      emitRO("ADD",ri,ri,ac1,"vector: address");
+      emitRO(tree->attr.vec == VecCopyK ? "MCPY" :
+             tree->attr.vec == VecAddK ? "VADD" : "VMUL",
+             ri,rb,rn,"vector: operation");
+      freeTemp();
+      break;
+    case VecFillK :
+      arrayBase(a,ac1);
+      emitRO("ADD",ri,ri,ac1,"vector: address");
+      genExp(b);
+      loadTemps(3);
+      emitRO("MSET",temp(1),temp(0),temp(2),"vector: fill");
+      freeTemp();
+      break;
+    case VecSumK :
+      x = lookup(b->attr.name);
+      arrayBase(a,ac1);
+      emitRO("ADD",ri,ri,ac1,"vector: address");
+      emitRO("VSUM",ri,ri,rn,"vector: sum");
+      emitRM("LD",rn,varDisp(x),varBase(x),"vector: load sum");
+      emitRO("ADD",rn,rn,ri,"vector: add");
+      emitRM("ST",rn,varDisp(x),varBase(x),"vector: store sum");
+      break;
+    case VecMinK :
+    case VecMaxK :
+      x = lookup(b->attr.name);
+      rb = newTemp();
+      arrayBase(a,ac1);
+      emitRO("ADD",rb,ri,ac1,"vector: address");
+      emitRM("LD",ac,varDisp(x),varBase(x),"vector: load best");
+      emitRO(tree->attr.vec == VecMinK ? "VMIN" : "VMAX",
+             ac,rb,rn,"vector: find");
+      skipLabel = emitNewLabel();
+      emitRM_Label("JLT",ac,skipLabel,"vector: skip if no better");
+      emitRO("ADD",ri,ri,ac,"vector: index found");
+      emitRO("ADD",rn,ri,ac1,"vector: its address");
+      emitRM("LD",rn,0,rn,"vector: load it");
+      emitRM("ST",rn,varDisp(x),varBase(x),"vector: store best");
+      if (b->sibling != NULL)
+      { x = lookup(b->sibling->attr.name);
+        emitRM("ST",ri,varDisp(x),varBase(x),"vector: store its index");
+      }
+      emitLabel(skipLabel);
+      freeTemp();
+      break;
+    default:
+      emitComment("BUG: Unknown vector operation");
+      break;
+  }
+  emitLabel(endLabel);
+  freeTemp();
+  freeTemp();
+  if (TraceCode) emitComment("<- vector loop") ;
+} /* genVec */
 
 /* Procedure genStmt generates code at a statement node */
 static void genStmt( TreeNode * tree)
 { TreeNode * p1, * p2, * p3;
-  int savedLoc1,savedLoc2,currentLoc;
-  int loc;
+  int elseLabel, endLabel;
+  int mark, saved;
   switch (tree->kind.stmt) {
 
-      case IfK :
+      case CompK :
+         mark = nvars;
+         saved = frameNext;
+         for (p1 = tree->child[0]; p1 != NULL; p1 = p1->sibling)
+         { if (p1->kind.decl == VarArrK)
+             bind(p1->attr.array.name,FrameV,1 + frameNext,TRUE);
+           else
+             bind(p1->attr.name,FrameV,1 + frameNext,FALSE);
+           frameNext += declSize(p1);
+         }
+         cGen(tree->child[1]);
+         nvars = mark;
+         frameNext = saved;
+         break; /* CompK */
+
+      case SelK :
          if (TraceCode) emitComment("-> if") ;
          p1 = tree->child[0] ;
          p2 = tree->child[1] ;
          p3 = tree->child[2] ;
          /* generate code for test expression */
-         cGen(p1);
-         savedLoc1 = emitSkip(1) ;
-         emitComment("if: jump to else belongs here");
+         elseLabel = emitNewLabel();
+         genCond(p1,elseLabel,"if: jmp to else");
          /* recurse on then part */
          cGen(p2);
-         savedLoc2 = emitSkip(1) ;
-         emitComment("if: jump to end belongs here");
-         currentLoc = emitSkip(0) ;
-         emitBackup(savedLoc1) ;
-         emitRM_Abs("JEQ",ac,currentLoc,"if: jmp to else");
-         emitRestore() ;
-         /* recurse on else part */
-         cGen(p3);
-         currentLoc = emitSkip(0) ;
-         emitBackup(savedLoc2) ;
-         emitRM_Abs("LDA",pc,currentLoc,"jmp to end") ;
-         emitRestore() ;
+         if (p3 != NULL)
+         { endLabel = emitNewLabel();
+           emitRM_Label("LDA",pc,endLabel,"jmp to end") ;
+         }
+         emitLabel(elseLabel);
+         if (p3 != NULL)
+         { /* recurse on else part */
+           cGen(p3);
+           emitLabel(endLabel);
+         }
          if (TraceCode)  emitComment("<- if") ;
-         break; /* if_k */
+         break; /* SelK */
+
+      case IterK:
+         if (TraceCode) emitComment("-> while") ;
+         elseLabel = emitNewLabel();
+         endLabel = emitNewLabel();
+         emitLabel(elseLabel);
+         genCond(tree->child[0],endLabel,"while: jmp to end");
+         cGen(tree->child[1]);
+         emitRM_Label("LDA",pc,elseLabel,"while: jmp back to test");
+         emitLabel(endLabel);
+         if (TraceCode)  emitComment("<- while") ;
+         break; /* IterK */
+
+      case RetK:
+         if (TraceCode) emitComment("-> return") ;
+         if (tree->child[0] != NULL)
+         { genExp(tree->child[0]);
+           loadTemps(1);
+           emitRM("LDA",ac,0,temp(0),"return value");
+           freeTemp();
+         }
+         if (frameSize + depth > 0)
+           emitRM("LDA",mp,frameSize + depth,mp,"free locals");
+         emitRet("return");
+         if (TraceCode)  emitComment("<- return") ;
+         break; /* RetK */
+
+      case VecK:
+         genVec(tree);
+         break; /* VecK */
 
-      case RepeatK:
-         if (TraceCode) emitComment("-> repeat") ;
-         p1 = tree->child[0] ;
-         p2 = tree->child[1] ;
-         savedLoc1 = emitSkip(0);
-         emitComment("repeat: jump after body comes back here");
-         /* generate code for body */
-         cGen(p1);
-         /* generate code for test */
-         cGen(p2);
-         emitRM_Abs("JEQ",ac,savedLoc1,"repeat: jmp back to body");
-         if (TraceCode)  emitComment("<- repeat") ;
-         break; /* repeat */
-
-      case AssignK:
-         if (TraceCode) emitComment("-> assign") ;
-         /* generate code for rhs */
-         cGen(tree->child[0]);
-         /* now store value */
-         loc = st_lookup(tree->attr.name);
-         emitRM("ST",ac,loc,gp,"assign: store value");
-         if (TraceCode)  emitComment("<- assign") ;
-         break; /* assign_k */
-
-      case ReadK:
-         emitRO("IN",ac,0,0,"read integer value");
-         loc = st_lookup(tree->attr.name);
-         emitRM("ST",ac,loc,gp,"read: store value");
-         break;
-      case WriteK:
-         /* generate code for expression to write */
-         cGen(tree->child[0]);
-         /* now output it */
-         emitRO("OUT",ac,0,0,"write ac");
-         break;
       default:
          break;
     }
 } /* genStmt */
 
-/* Procedure genExp generates code at an expression node */
-static void genExp( TreeNode * tree)
-{ int loc;
-  TreeNode * p1, * p2;
-  switch (tree->kind.exp) {
+/* Procedure genDecl generates code at a global
+ * declaration node
+ */
+static void genDecl( TreeNode * tree)
+{ TreeNode * p;
+  int mark, r, nparams = 0, k = 0;
+  switch (tree->kind.decl) {
 
-    case ConstK :
-      if (TraceCode) emitComment("-> Const") ;
-      /* gen code to load integer constant using LDC */
-      emitRM("LDC",ac,tree->attr.val,0,"load const");
-      if (TraceCode)  emitComment("<- Const") ;
-      break; /* ConstK */
-    
-    case IdK :
-      if (TraceCode) emitComment("-> Id") ;
-      loc = st_lookup(tree->attr.name);
-      emitRM("LD",ac,loc,gp,"load id value");
-      if (TraceCode)  emitComment("<- Id") ;
-      break; /* IdK */
+      case VarK :
+         bind(tree->attr.name,GlobalV,globalNext,FALSE);
+         globalNext++;
+         break; /* VarK */
 
-    case OpK :
-         if (TraceCode) emitComment("-> Op") ;
-         p1 = tree->child[0];
-         p2 = tree->child[1];
-         /* gen code for ac = left arg */
-         cGen(p1);
-         /* gen code to push left operand */
-         emitRM("ST",ac,tmpOffset--,mp,"op: push left");
-         /* gen code for ac = right operand */
-         cGen(p2);
-         /* now load left operand */
-         emitRM("LD",ac1,++tmpOffset,mp,"op: load left");
-         switch (tree->attr.op) {
-            case PLUS :
-               emitRO("ADD",ac,ac1,ac,"op +");
-               break;
-            case MINUS :
-               emitRO("SUB",ac,ac1,ac,"op -");
-               break;
-            case TIMES :
-               emitRO("MUL",ac,ac1,ac,"op *");
-               break;
-            case OVER :
-               emitRO("DIV",ac,ac1,ac,"op /");
-               break;
-            case LT :
-               emitRO("SUB",ac,ac1,ac,"op <") ;
-               emitRM("JLT",ac,2,pc,"br if true") ;
-               emitRM("LDC",ac,0,ac,"false case") ;
-               emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
-               break;
-            case EQ :
-               emitRO("SUB",ac,ac1,ac,"op ==") ;
-               emitRM("JEQ",ac,2,pc,"br if true");
-               emitRM("LDC",ac,0,ac,"false case") ;
-               emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
-               break;
-            default:
-               emitComment("BUG: Unknown operator");
-               break;
-         } /* case op */
-         if (TraceCode)  emitComment("<- Op") ;
-         break; /* OpK */
+      case VarArrK :
+         bind(tree->attr.array.name,GlobalV,globalNext,TRUE);
+         globalNext += tree->attr.array.size;
+         break; /* VarArrK */
 
-    default:
-      break;
-  }
-} /* genExp */
+      case FunK :
+         if (TraceCode) emitComment("-> function") ;
+         emitComment(tree->attr.name);
+         funcName = tree->attr.name;
+         r = strcmp(funcName,"main") == 0 ? mainLabel : emitNewLabel();
+         emitLabel(r);
+         bind(funcName,FunV,r,FALSE);
+         mark = nvars;
+         for (p = tree->child[0]; p != NULL; p = p->sibling)
+           if (p->attr.name != NULL) nparams++;
+         frameSize = localSize(tree->child[1]);
+         frameNext = 0;
+         depth = 0;
+         for (p = tree->child[0]; p != NULL; p = p->sibling)
+           if (p->attr.name != NULL)
+             bind(p->attr.name,p->kind.param == ArrParamK ? RefV : FrameV,
+                  frameSize + 2 + nparams - 1 - k++,FALSE);
+         emitSource(tree->lineno,funcName);
+         if (frameSize > 0)
+           emitRM("LDA",mp,-frameSize,mp,"take locals");
+         cGen(tree->child[1]);
+         /* return at the end of the body */
+         if (frameSize > 0)
+           emitRM("LDA",mp,frameSize,mp,"free locals");
+         emitRet("return");
+         nvars = mark;
+         funcName = NULL;
+         if (TraceCode)  emitComment("<- function") ;
+         break; /* FunK */
+
+      default:
+         break;
+    }
+} /* genDecl */
 
 /* Procedure cGen recursively generates code by
  * tree traversal
  */
 static void cGen( TreeNode * tree)
-{ if (tree != NULL)
-  { switch (tree->nodekind) {
+{ while (tree != NULL)
+  { emitSource(tree->lineno,funcName);
+    switch (tree->nodekind) {
       case StmtK:
         genStmt(tree);
         break;
       case ExpK:
-        genExp(tree);
+        /* an expression statement: the value is dropped */
+        if (tree->kind.exp == CallK) genCall(tree,FALSE);
+        else
+        { genExp(tree);
+          freeTemp();
+        }
+        break;
+      case DeclK:
+        genDecl(tree);
         break;
       default:
         break;
     }
-    cGen(tree->sibling);
+    tree = tree->sibling;
   }
 }
 
@@ -197,16 +701,19 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
 {  char * s = malloc(strlen(codefile)+7);
    strcpy(s,"File: ");
    strcat(s,codefile);
-   emitComment("TINY Compilation to TM Code");
+   emitComment("C-MINUS Compilation to TM Code");
    emitComment(s);
    /* generate standard prelude */
    emitComment("Standard prelude:");
    emitRM("LD",mp,0,ac,"load maxaddress from location 0");
    emitRM("ST",ac,0,ac,"clear location 0");
    emitComment("End of standard prelude.");
-   /* generate code for TINY program */
-   cGen(syntaxTree);
-   /* finish */
+   /* call main, then finish */
+   mainLabel = emitNewLabel();
+   emitCall(mainLabel,"call main");
    emitComment("End of execution.");
    emitRO("HALT",0,0,0,"");
+   /* generate code for C-MINUS program */
+   cGen(syntaxTree);
+   emitEnd();
 }
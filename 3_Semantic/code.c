@@ -1,27 +1,121 @@
 /****************************************************/
 /* File: code.c                                     */
 /* TM Code emitting utilities                       */
-/* implementation for the TINY compiler             */
+/* implementation for the C-MINUS compiler          */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
 
+#include <stdarg.h>
 #include "globals.h"
 #include "code.h"
+#include "tm.h"
 
-/* TM location number for current instruction emission */
-static int emitLoc = 0 ;
+/* use the TM stack instructions (see code.h);
+ * main.c sets it from STACK_CODE */
+int StackCode = FALSE;
 
-/* Highest TM location emitted so far
-   For use in conjunction with emitSkip,
-   emitBackup, and emitRestore */
-static int highEmitLoc = 0;
+/* the code emitted so far; the instructions go at
+ * buf.size, the next location */
+static CodeBuf buf = { NULL, 0, NULL, 0, NULL, 0 };
+static int instrCap = 0;
+static int labelCap = 0;
+static int commentCap = 0;
 
-/* Procedure emitComment prints a comment line 
+/* source position of the instructions being
+ * emitted, set by emitSource */
+static int srcLine = 0;
+static char * srcFunc = NULL;
+
+/* the passes emitEnd runs, in order */
+#define MAXPASSES 16
+static CodePass passes[MAXPASSES];
+static int npasses = 0;
+
+/* the code file text, written at once by emitEnd */
+static char * text = NULL;
+static long textLen = 0;
+static long textCap = 0;
+
+/* opcode mnemonics, for looking up the
+ * numbers of the opcodes emitted */
+static char * opCodeTab[] = TM_OPCODE_NAMES;
+
+/* Function grow makes room for one more of the
+ * n elements of size bytes at p, which has room
+ * for *cap; it gives the new p
+ */
+static void * grow( void * p, int * cap, int n, int size)
+{ if (n < *cap) return p;
+  *cap = *cap ? 2 * *cap : 256;
+  p = realloc(p,(size_t) *cap * size);
+  if (p == NULL)
+  { fprintf(listing,"Out of memory for the code buffer\n");
+    exit(1);
+  }
+  return p;
+} /* grow */
+
+/* Function keepText gives a copy of comment c if
+ * comments are printed, else NULL
+ */
+static char * keepText( char * c)
+{ char * t;
+  if (!TraceCode || (c == NULL)) return NULL;
+  t = malloc(strlen(c) + 1);
+  if (t == NULL)
+  { fprintf(listing,"Out of memory for the code buffer\n");
+    exit(1);
+  }
+  return strcpy(t,c);
+} /* keepText */
+
+/* Procedure emitInstr appends an instruction to
+ * the code buffer
+ */
+static void emitInstr( char * op, int r, int s, int t, int d,
+                       int label, char * c)
+{ CodeInstr * in;
+  int i = 0;
+  while ((i < opRALim) && (strcmp(opCodeTab[i],op) != 0))
+    i++;
+  if (i >= opRALim)
+  { emitComment("BUG: unknown opcode in emitInstr");
+    return;
+  }
+  buf.instr = (CodeInstr *) grow(buf.instr,&instrCap,buf.size,
+                                 sizeof(CodeInstr));
+  in = &buf.instr[buf.size++];
+  in->op = i;
+  in->r = r;
+  in->s = s;
+  in->t = t;
+  in->d = d;
+  in->label = label;
+  in->line = srcLine;
+  in->func = srcFunc;
+  in->comment = keepText(c);
+} /* emitInstr */
+
+/* Procedure emitSource sets the source line and
+ * function (NULL outside functions) that the
+ * instructions emitted next come from
+ */
+void emitSource( int line, char * func )
+{ srcLine = line;
+  srcFunc = func;
+} /* emitSource */
+
+/* Procedure emitComment prints a comment line
  * with comment c in the code file
  */
 void emitComment( char * c )
-{ if (TraceCode) fprintf(code,"* %s\n",c);}
+{ if (!TraceCode) return;
+  buf.comments = (CodeComment *) grow(buf.comments,&commentCap,
+                                      buf.ncomments,sizeof(CodeComment));
+  buf.comments[buf.ncomments].loc = buf.size;
+  buf.comments[buf.ncomments++].text = keepText(c);
+} /* emitComment */
 
 /* Procedure emitRO emits a register-only
  * TM instruction
@@ -32,11 +126,7 @@ void emitComment( char * c )
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRO( char *op, int r, int s, int t, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d,%d ",emitLoc++,op,r,s,t);
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
-  if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
-} /* emitRO */
+{ emitInstr(op,r,s,t,0,-1,c); } /* emitRO */
 
 /* Procedure emitRM emits a register-to-memory
  * TM instruction
@@ -47,51 +137,217 @@ void emitRO( char *op, int r, int s, int t, char *c)
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRM( char * op, int r, int d, int s, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",emitLoc++,op,r,d,s);
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
-  if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
-} /* emitRM */
-
-/* Function emitSkip skips "howMany" code
- * locations for later backpatch. It also
- * returns the current code position
- */
-int emitSkip( int howMany)
-{  int i = emitLoc;
-   emitLoc += howMany ;
-   if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
-   return i;
-} /* emitSkip */
-
-/* Procedure emitBackup backs up to 
- * loc = a previously skipped location
- */
-void emitBackup( int loc)
-{ if (loc > highEmitLoc) emitComment("BUG in emitBackup");
-  emitLoc = loc ;
-} /* emitBackup */
-
-/* Procedure emitRestore restores the current 
- * code position to the highest previously
- * unemitted position
- */
-void emitRestore(void)
-{ emitLoc = highEmitLoc;}
-
-/* Procedure emitRM_Abs converts an absolute reference 
- * to a pc-relative reference when emitting a
- * register-to-memory TM instruction
+{ emitInstr(op,r,s,0,d,-1,c); } /* emitRM */
+
+/* Function emitNewLabel gives a new label, to be
+ * placed by emitLabel
+ */
+int emitNewLabel(void)
+{ buf.labels = (int *) grow(buf.labels,&labelCap,buf.nlabels,sizeof(int));
+  buf.labels[buf.nlabels] = -1;
+  return buf.nlabels++;
+} /* emitNewLabel */
+
+/* Procedure emitLabel places label at the
+ * location of the next instruction emitted
+ */
+void emitLabel( int label)
+{ buf.labels[label] = buf.size; } /* emitLabel */
+
+/* Procedure emitRM_Label emits a register-to-memory
+ * TM instruction referring to a label
  * op = the opcode
  * r = target register
- * a = the absolute location in memory
+ * label = the label
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitRM_Label( char *op, int r, int label, char * c)
+{ emitInstr(op,r,pc,0,0,label,c); } /* emitRM_Label */
+
+/* Procedure emitPush emits code pushing
+ * register r on the stack
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM_Abs( char *op, int r, int a, char * c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",
-               emitLoc,op,r,a-(emitLoc+1),pc);
-  ++emitLoc ;
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
-  if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
-} /* emitRM_Abs */
+void emitPush( int r, char * c)
+{ if (StackCode) emitRO("PUSH",r,mp,0,c);
+  else
+  { emitRM("ST",r,0,mp,c);
+    emitRM("LDA",mp,-1,mp,"push: grow stack");
+  }
+} /* emitPush */
+
+/* Procedure emitPop emits code popping the
+ * top of the stack into register r
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitPop( int r, char * c)
+{ if (StackCode) emitRO("POP",r,mp,0,c);
+  else
+  { emitRM("LDA",mp,1,mp,"pop: shrink stack");
+    emitRM("LD",r,0,mp,c);
+  }
+} /* emitPop */
+
+/* Procedure emitCall emits a call of the code
+ * at label, pushing the return address; without
+ * StackCode it uses ac1
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitCall( int label, char * c)
+{ int ret;
+  if (StackCode) emitInstr("CALL",mp,pc,0,0,label,c);
+  else
+  { ret = emitNewLabel();
+    emitRM_Label("LDA",ac1,ret,"call: return address");
+    emitPush(ac1,"call: push return address");
+    emitRM_Label("LDA",pc,label,c);
+    emitLabel(ret);
+  }
+} /* emitCall */
+
+/* Procedure emitRet emits a return to the
+ * address on top of the stack
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitRet( char * c)
+{ if (StackCode) emitRO("RET",0,mp,0,c);
+  else emitPop(pc,c);
+} /* emitRet */
+
+/* Procedure emitPass adds pass to the end of the
+ * passes emitEnd runs over the code buffer
+ */
+void emitPass( CodePass pass )
+{ if (npasses < MAXPASSES) passes[npasses++] = pass;
+  else fprintf(listing,"BUG: too many code passes\n");
+} /* emitPass */
+
+/* isJump tells whether in is a jump to a label */
+static int isJump( CodeInstr * in)
+{ return (in->label >= 0)
+         && ( ((in->op == opLDA) && (in->r == pc))
+              || ((in->op >= opJLT) && (in->op <= opJNE)) );
+}
+
+/* Procedure threadJumps is a pass: a jump to an
+ * unconditional jump goes where that one goes
+ */
+void threadJumps( CodeBuf * buf )
+{ CodeInstr * in, * to;
+  int loc, n;
+  for (loc = 0; loc < buf->size; loc++)
+  { in = &buf->instr[loc];
+    if (!isJump(in)) continue;
+    /* n bounds the chain, in case it is a loop */
+    for (n = 0; n < buf->size; n++)
+    { if (buf->labels[in->label] >= buf->size) break;
+      to = &buf->instr[buf->labels[in->label]];
+      if ((to == in) || !isJump(to) || (to->op != opLDA)) break;
+      in->label = to->label;
+    }
+  }
+} /* threadJumps */
+
+/* Procedure compact drops the instructions a pass
+ * has deleted, moving their labels and comments
+ * to the next one kept
+ */
+static void compact(void)
+{ int * newLoc;
+  int loc, size = 0;
+  newLoc = (int *) malloc((buf.size + 1) * sizeof(int));
+  if (newLoc == NULL)
+  { fprintf(listing,"Out of memory for the code buffer\n");
+    exit(1);
+  }
+  for (loc = 0; loc < buf.size; loc++)
+  { newLoc[loc] = size;
+    if (buf.instr[loc].op != DELETED) buf.instr[size++] = buf.instr[loc];
+  }
+  newLoc[buf.size] = size;
+  for (loc = 0; loc < buf.nlabels; loc++)
+    if (buf.labels[loc] >= 0) buf.labels[loc] = newLoc[buf.labels[loc]];
+  for (loc = 0; loc < buf.ncomments; loc++)
+    buf.comments[loc].loc = newLoc[buf.comments[loc].loc];
+  buf.size = size;
+  free(newLoc);
+} /* compact */
+
+/* Procedure textf appends to the code file text */
+static void textf( char * fmt, ...)
+{ va_list ap;
+  int n;
+  for (;;)
+  { va_start(ap,fmt);
+    n = vsnprintf(text + textLen,textCap - textLen,fmt,ap);
+    va_end(ap);
+    if (textLen + n < textCap) break;
+    textCap = textCap ? 2 * textCap : 65536;
+    while (textLen + n >= textCap) textCap *= 2;
+    text = realloc(text,textCap);
+    if (text == NULL)
+    { fprintf(listing,"Out of memory for the code file\n");
+      exit(1);
+    }
+  }
+  textLen += n;
+} /* textf */
+
+/* Procedure emitEnd finishes code emission: the
+ * passes are run, the labels resolved, and the
+ * code file written, with the binary code file
+ * and the line table, if any
+ */
+void emitEnd(void)
+{ TMBHEADER hdr;
+  TMBINSTR * obj;
+  CodeInstr * in;
+  int loc, i, c = 0;
+  for (i = 0; i < npasses; i++)
+  { passes[i](&buf);
+    compact();
+  }
+  for (loc = 0; loc < buf.size; loc++)
+  { in = &buf.instr[loc];
+    if (in->label < 0) continue;
+    if (buf.labels[in->label] < 0)
+      fprintf(listing,"BUG: label %d not placed\n",in->label);
+    in->d = buf.labels[in->label] - (loc + 1);
+  }
+  for (loc = 0; loc <= buf.size; loc++)
+  { for (; (c < buf.ncomments) && (buf.comments[c].loc == loc); c++)
+      textf("* %s\n",buf.comments[c].text);
+    if (loc == buf.size) break;
+    in = &buf.instr[loc];
+    if (in->op < opRRLim)
+      textf("%3d:  %5s  %d,%d,%d ",loc,opCodeTab[in->op],in->r,in->s,in->t);
+    else
+      textf("%3d:  %5s  %d,%d(%d) ",loc,opCodeTab[in->op],in->r,in->d,in->s);
+    if (in->comment != NULL) textf("\t%s",in->comment);
+    textf("\n");
+  }
+  fwrite(text,1,textLen,code);
+  if (codeLines != NULL)
+  { fprintf(codeLines,"* TM line table: location source-line function\n");
+    for (loc = 0; loc < buf.size; loc++)
+      if (buf.instr[loc].line > 0)
+        fprintf(codeLines,"%d %d %s\n",loc,buf.instr[loc].line,
+                buf.instr[loc].func == NULL ? "-" : buf.instr[loc].func);
+  }
+  if (codeObj == NULL) return;
+  obj = (TMBINSTR *) malloc((buf.size + 1) * sizeof(TMBINSTR));
+  if (obj == NULL)
+  { fprintf(listing,"Out of memory for the code file\n");
+    exit(1);
+  }
+  for (loc = 0; loc < buf.size; loc++)
+  { in = &buf.instr[loc];
+    obj[loc].code = TMB_CODE(in->op,in->r,in->s,in->t);
+    obj[loc].disp = in->d;
+  }
+  hdr.magic = TMB_MAGIC;
+  hdr.size = buf.size;
+  fwrite(&hdr,sizeof(hdr),1,codeObj);
+  fwrite(obj,sizeof(TMBINSTR),buf.size,codeObj);
+  free(obj);
+} /* emitEnd */
@@ -1,6 +1,6 @@
 /****************************************************/
 /* File: code.h                                     */
-/* Code emitting utilities for the TINY compiler    */
+/* Code emitting utilities for the C-MINUS compiler */
 /* and interface to the TM machine                  */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
@@ -29,6 +29,61 @@
 /* 2nd accumulator */
 #define  ac1 1
 
+/* StackCode = TRUE has emitPush, emitPop, emitCall
+ * and emitRet use the TM stack instructions (PUSH,
+ * POP, CALL and RET); FALSE gives the ST, LD and
+ * LDA sequences any TM runs. The stack grows down
+ * from mp, which points at the first free word.
+ */
+extern int StackCode;
+
+/* An instruction in the code buffer. One that
+ * refers to a label (a jump, or the return
+ * address of a call) is pc-relative: s is pc and
+ * d is filled in from the label when the code is
+ * written.
+ */
+typedef struct
+   { int op ;        /* opcode number (tm.h), or DELETED */
+     int r, s, t, d ;
+     int label ;     /* -1 for none */
+     int line ;      /* source position, for the line table */
+     char * func ;
+     char * comment ;
+   } CodeInstr;
+
+/* op of an instruction a pass has deleted */
+#define DELETED (-1)
+
+/* a comment line, printed before location loc */
+typedef struct
+   { int loc ;
+     char * text ;
+   } CodeComment;
+
+/* The code buffer: the instructions emitted, the
+ * location each label is at (the instruction it
+ * comes before; size for the end of the code),
+ * and the comment lines. Locations are indices
+ * in instr, so a pass that moves instructions
+ * must move the labels and comments with them.
+ */
+typedef struct
+   { CodeInstr * instr ;
+     int size ;
+     int * labels ;
+     int nlabels ;
+     CodeComment * comments ;
+     int ncomments ;
+   } CodeBuf;
+
+/* A pass rewrites the code buffer before it is
+ * written. It may delete instructions by setting
+ * their op to DELETED; they are dropped when it
+ * returns.
+ */
+typedef void (* CodePass) (CodeBuf * buf);
+
 /* code emitting utilities */
 
 /* Procedure emitComment prints a comment line 
@@ -56,31 +111,75 @@ void emitRO( char *op, int r, int s, int t, char *c);
  */
 void emitRM( char * op, int r, int d, int s, char *c);
 
-/* Function emitSkip skips "howMany" code
- * locations for later backpatch. It also
- * returns the current code position
- */
-int emitSkip( int howMany);
-
-/* Procedure emitBackup backs up to 
- * loc = a previously skipped location
+/* Function emitNewLabel gives a new label, to be
+ * placed by emitLabel; it may be referred to
+ * before that
  */
-void emitBackup( int loc);
+int emitNewLabel(void);
 
-/* Procedure emitRestore restores the current 
- * code position to the highest previously
- * unemitted position
+/* Procedure emitLabel places label at the
+ * location of the next instruction emitted
  */
-void emitRestore(void);
+void emitLabel( int label);
 
-/* Procedure emitRM_Abs converts an absolute reference 
- * to a pc-relative reference when emitting a
- * register-to-memory TM instruction
+/* Procedure emitRM_Label emits a register-to-memory
+ * TM instruction referring to a label, which is
+ * made a pc-relative reference when the code is
+ * written
  * op = the opcode
  * r = target register
- * a = the absolute location in memory
+ * label = the label
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitRM_Label( char *op, int r, int label, char * c);
+
+/* Procedure emitPush emits code pushing
+ * register r on the stack
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitPush( int r, char * c);
+
+/* Procedure emitPop emits code popping the
+ * top of the stack into register r
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitPop( int r, char * c);
+
+/* Procedure emitCall emits a call of the code
+ * at label, pushing the return address; without
+ * StackCode it uses ac1
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitCall( int label, char * c);
+
+/* Procedure emitRet emits a return to the
+ * address on top of the stack
  * c = a comment to be printed if TraceCode is TRUE
  */
-void emitRM_Abs( char *op, int r, int a, char * c);
+void emitRet( char * c);
+
+/* Procedure emitSource sets the source line and
+ * function (NULL outside functions) that the
+ * instructions emitted next come from, for the
+ * line table file (.tml), if any
+ */
+void emitSource( int line, char * func );
+
+/* Procedure emitPass adds pass to the end of the
+ * passes emitEnd runs over the code buffer
+ */
+void emitPass( CodePass pass );
+
+/* Procedure threadJumps is a pass: a jump to an
+ * unconditional jump goes where that one goes
+ */
+void threadJumps( CodeBuf * buf );
+
+/* Procedure emitEnd finishes code emission: the
+ * passes are run, the labels resolved, and the
+ * code file written, with the binary code file
+ * and the line table, if any
+ */
+void emitEnd(void);
 
 #endif
@@ -0,0 +1,193 @@
+/****************************************************/
+/* File: fold.c                                     */
+/* Constant folding for the C-MINUS compiler:       */
+/* operators on constants are worked out, and the   */
+/* code they leave out is dropped                   */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include "globals.h"
+#include "fold.h"
+
+/* An operator on constants becomes a constant,
+ * with the value the TM code would compute:
+ * +, - and * wrap around, and a comparison tests
+ * the wrapped difference, as cgen.c does. The
+ * least int divided by -1 wraps around to itself,
+ * as in the TM; a division by 0, which stops the
+ * TM, is left for it to do.
+ *
+ * Then, for e without calls, assignments, array
+ * elements or divisions that could stop the TM,
+ *
+ *   x+0, 0+x, x-0, x*1, 1*x, x/1   become x
+ *   e*0, 0*e, e-e                 become 0
+ *
+ * An if or while on a constant keeps only the
+ * part that runs; a statement left with nothing
+ * to do becomes an empty compound statement.
+ */
+
+static int isConst(TreeNode * t, int val)
+{ return (t != NULL) && (t->nodekind == ExpK) && (t->kind.exp == ConstK)
+         && (t->attr.val == val);
+}
+
+static int isConstant(TreeNode * t)
+{ return (t != NULL) && (t->nodekind == ExpK) && (t->kind.exp == ConstK);
+}
+
+/* pure tells whether e may be left out: it has
+ * no calls, assignments or array elements, and
+ * divides only by constants other than 0
+ */
+static int pure(TreeNode * e)
+{ if ((e == NULL) || (e->nodekind != ExpK)) return FALSE;
+  switch (e->kind.exp)
+  { case ConstK:
+    case IdK:
+      return TRUE;
+    case OpK:
+    case RelopK:
+      if ((e->attr.op == OVER)
+          && (!isConstant(e->child[1]) || isConst(e->child[1],0)))
+        return FALSE;
+      return pure(e->child[0]) && pure(e->child[1]);
+    default:
+      return FALSE;
+  }
+}
+
+/* same tells whether pure expressions s and t
+ * are written the same
+ */
+static int same(TreeNode * s, TreeNode * t)
+{ if ((s->nodekind != t->nodekind) || (s->kind.exp != t->kind.exp))
+    return FALSE;
+  switch (s->kind.exp)
+  { case ConstK:
+      return s->attr.val == t->attr.val;
+    case IdK:
+      return strcmp(s->attr.name,t->attr.name) == 0;
+    default:
+      return (s->attr.op == t->attr.op)
+             && same(s->child[0],t->child[0]) && same(s->child[1],t->child[1]);
+  }
+}
+
+/* makeConst makes expression t the constant val */
+static void makeConst(TreeNode * t, int val)
+{ int i;
+  for (i = 0; i < MAXCHILDREN; i++) t->child[i] = NULL;
+  t->kind.exp = ConstK;
+  t->attr.val = val;
+  t->type = Integer;
+}
+
+/* replace puts node s in the place of t, which
+ * keeps its siblings
+ */
+static void replace(TreeNode * t, TreeNode * s)
+{ TreeNode * sibling = t->sibling;
+  *t = *s;
+  t->sibling = sibling;
+}
+
+/* makeEmpty makes statement t do nothing */
+static void makeEmpty(TreeNode * t)
+{ int i;
+  for (i = 0; i < MAXCHILDREN; i++) t->child[i] = NULL;
+  t->kind.stmt = CompK;
+}
+
+/* compute gives the value of x op y, as the TM
+ * code computes it; FALSE if the TM stops
+ */
+static int compute(TokenType op, int x, int y, int * val)
+{ unsigned diff = (unsigned) x - (unsigned) y;
+  switch (op)
+  { case PLUS:
+      *val = (int) ((unsigned) x + (unsigned) y);
+      return TRUE;
+    case MINUS:
+      *val = (int) diff;
+      return TRUE;
+    case TIMES:
+      *val = (int) ((unsigned) x * (unsigned) y);
+      return TRUE;
+    case OVER:
+      if (y == 0) return FALSE;
+      *val = (y == -1) ? (int) (0u - (unsigned) x) : x / y;
+      return TRUE;
+    case LT: *val = (int) diff < 0; return TRUE;
+    case LE: *val = (int) diff <= 0; return TRUE;
+    case GT: *val = (int) diff > 0; return TRUE;
+    case GE: *val = (int) diff >= 0; return TRUE;
+    case EQ: *val = diff == 0; return TRUE;
+    case NE: *val = diff != 0; return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/* foldOp simplifies operator node t, whose
+ * operands are already folded
+ */
+static void foldOp(TreeNode * t)
+{ TreeNode * x = t->child[0], * y = t->child[1];
+  int val;
+  if (isConstant(x) && isConstant(y))
+  { if (compute(t->attr.op,x->attr.val,y->attr.val,&val))
+      makeConst(t,val);
+    return;
+  }
+  if (t->kind.exp != OpK) return;
+  switch (t->attr.op)
+  { case PLUS:
+      if (isConst(y,0)) replace(t,x);
+      else if (isConst(x,0)) replace(t,y);
+      break;
+    case MINUS:
+      if (isConst(y,0)) replace(t,x);
+      else if (pure(x) && pure(y) && same(x,y)) makeConst(t,0);
+      break;
+    case TIMES:
+      if (isConst(y,1)) replace(t,x);
+      else if (isConst(x,1)) replace(t,y);
+      else if ((isConst(y,0) && pure(x)) || (isConst(x,0) && pure(y)))
+        makeConst(t,0);
+      break;
+    case OVER:
+      if (isConst(y,1)) replace(t,x);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Procedure fold works out the operators on
+ * constants of a type checked syntax tree, drops
+ * operations that do nothing, and the branches of
+ * if and while statements that never run
+ */
+void fold(TreeNode * t)
+{ TreeNode * s;
+  int i;
+  for (; t != NULL; t = t->sibling)
+  { for (i = 0; i < MAXCHILDREN; i++)
+      fold(t->child[i]);
+    if ((t->nodekind == ExpK)
+        && ((t->kind.exp == OpK) || (t->kind.exp == RelopK)))
+      foldOp(t);
+    else if ((t->nodekind == StmtK) && (t->kind.stmt == SelK)
+             && isConstant(t->child[0]))
+    { s = (t->child[0]->attr.val != 0) ? t->child[1] : t->child[2];
+      if (s != NULL) replace(t,s);
+      else makeEmpty(t);
+    }
+    else if ((t->nodekind == StmtK) && (t->kind.stmt == IterK)
+             && isConst(t->child[0],0))
+      makeEmpty(t);
+  }
+}
@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: fold.h                                     */
+/* Constant folding for the C-MINUS compiler        */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+/* Procedure fold works out the operators on
+ * constants of a type checked syntax tree, drops
+ * operations that do nothing, and the branches of
+ * if and while statements that never run
+ */
+void fold(TreeNode *);
+
+#endif
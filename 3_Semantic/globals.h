@@ -55,6 +55,8 @@ typedef int TokenType;
 extern FILE* source; /* source code text file */
 extern FILE* listing; /* listing output text file */
 extern FILE* code; /* code text file for TM simulator */
+extern FILE* codeObj; /* binary code file (.tmb), or NULL */
+extern FILE* codeLines; /* line table file (.tml), or NULL */
 
 extern int lineno; /* source line number for listing */
 
@@ -63,11 +65,18 @@ extern int lineno; /* source line number for listing */
 /**************************************************/
 
 typedef enum {StmtK,DeclK,ExpK,ParamK} NodeKind;
-typedef enum {CompK,SelK,IterK,RetK} StmtKind;
+typedef enum {CompK,SelK,IterK,RetK,VecK} StmtKind;
 typedef enum {VarK,VarArrK,FunK} DeclKind;
 typedef enum {AssignK,RelopK,OpK,ConstK,IdK,IdArrK,CallK} ExpKind;
 typedef enum {SingleParamK,ArrParamK} ParamKind;
 
+/* VecKind is the operation of a VecK node: a
+ * counted while loop over arrays that vectorize
+ * turned into a TM block or vector instruction
+ */
+typedef enum {VecCopyK,VecFillK,VecAddK,VecMulK,VecSumK,VecMinK,VecMaxK}
+        VecKind;
+
 /* ExpType is used for type checking */
 typedef enum {Void,Integer,VoidArray,IntegerArray,Boolean,TypeError} ExpType;
 
@@ -91,6 +100,7 @@ typedef struct treeNode
              int val;
              char * name;
              ArrayAttr array;
+             VecKind vec;
              struct ScopeListRec * scope; } attr;
      ExpType type; /* for type checking of exps */
    } TreeNode;
@@ -16,7 +16,43 @@
 /* set NO_CODE to TRUE to get a compiler that does not
  * generate code
  */
-#define NO_CODE TRUE
+#define NO_CODE FALSE
+
+/* set VECTORIZE to FALSE to compile while loops
+ * over arrays a word at a time, without the TM
+ * block and vector instructions
+ */
+#define VECTORIZE TRUE
+
+/* set FOLD to FALSE to compile operators on
+ * constants as they are written, without working
+ * them out first
+ */
+#define FOLD TRUE
+
+/* set OPTIMIZE to FALSE to write the code as it
+ * is generated, without the passes over it
+ */
+#define OPTIMIZE TRUE
+
+/* set STACK_CODE to TRUE to push, pop, call and
+ * return with the TM stack instructions (PUSH,
+ * POP, CALL and RET) rather than ST, LD and LDA
+ * sequences
+ */
+#define STACK_CODE FALSE
+
+/* set EMIT_OBJECT to TRUE to also write the code
+ * as a binary TM object (.tmb) file, which the
+ * simulator loads without parsing
+ */
+#define EMIT_OBJECT FALSE
+
+/* set EMIT_LINES to TRUE to also write a line
+ * table (.tml) giving the source line and function
+ * of each code location, for the TM profiler
+ */
+#define EMIT_LINES FALSE
 
 #include "util.h"
 #if NO_PARSE
@@ -26,7 +62,11 @@
 #if !NO_ANALYZE
 #include "analyze.h"
 #if !NO_CODE
+#include "fold.h"
+#include "vectorize.h"
+#include "code.h"
 #include "cgen.h"
+#include "peephole.h"
 #endif
 #endif
 #endif
@@ -36,6 +76,8 @@ int lineno = 0;
 FILE * source;
 FILE * listing;
 FILE * code;
+FILE * codeObj = NULL;
+FILE * codeLines = NULL;
 
 /* allocate and set tracing flags */
 int EchoSource = FALSE;
@@ -80,6 +122,12 @@ int main( int argc, char * argv[] )
     if (TraceAnalyze) fprintf(listing,"\nType Checking Finished\n");
   }
 #if !NO_CODE
+#if FOLD
+  if (! Error) fold(syntaxTree);
+#endif
+#if VECTORIZE
+  if (! Error) vectorize(syntaxTree);
+#endif
   if (! Error)
   { char * codefile;
     int fnlen = strcspn(pgm,".");
@@ -91,8 +139,37 @@ int main( int argc, char * argv[] )
     { printf("Unable to open %s\n",codefile);
       exit(1);
     }
+#if EMIT_OBJECT
+    { char * objfile = (char *) calloc(fnlen+5, sizeof(char));
+      strncpy(objfile,pgm,fnlen);
+      strcat(objfile,".tmb");
+      codeObj = fopen(objfile,"wb");
+      if (codeObj == NULL)
+      { printf("Unable to open %s\n",objfile);
+        exit(1);
+      }
+    }
+#endif
+#if EMIT_LINES
+    { char * linefile = (char *) calloc(fnlen+5, sizeof(char));
+      strncpy(linefile,pgm,fnlen);
+      strcat(linefile,".tml");
+      codeLines = fopen(linefile,"w");
+      if (codeLines == NULL)
+      { printf("Unable to open %s\n",linefile);
+        exit(1);
+      }
+    }
+#endif
+    StackCode = STACK_CODE;
+#if OPTIMIZE
+    emitPass(threadJumps);
+    emitPass(peephole);
+#endif
     codeGen(syntaxTree,codefile);
     fclose(code);
+    if (codeObj != NULL) fclose(codeObj);
+    if (codeLines != NULL) fclose(codeLines);
   }
 #endif
 #endif
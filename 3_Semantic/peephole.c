@@ -0,0 +1,516 @@
+/****************************************************/
+/* File: peephole.c                                 */
+/* Peephole optimizer for the TM code of the        */
+/* C-MINUS compiler: a window slides over the code  */
+/* buffer, and sequences matching a rule are        */
+/* replaced                                         */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "peephole.h"
+#include "tm.h"
+
+/* A rule is a pattern of up to MAXWINDOW
+ * instructions, the instructions that replace
+ * them (no more), and a condition, if any. They
+ * are written in TM assembly with variables:
+ *
+ *   a..z   a register or a displacement, the same
+ *          value wherever it is used in the rule
+ *   A..Z   a label, the d of a jump
+ *   -x     x negated, and x+y, in replacements
+ *   Jcc    any of JLT..JNE, the same in the rule
+ *
+ * and pc, mp, gp and ac by name. A pattern matches
+ * consecutive instructions with no label placed
+ * at any but the first, except for labels of the
+ * pattern that only its instructions refer to.
+ *
+ * The conditions tell whether a register is live
+ * after the window by following the code from
+ * there, taking the calling convention of cgen.c:
+ * a function returns its value in ac, and leaves
+ * no other register but mp and gp to its caller.
+ */
+
+#define MAXWINDOW 5
+
+/* the most sweeps over the code, and instructions
+ * followed to find whether a register is live */
+#define MAXSWEEPS 16
+#define LIVEBUDGET 256
+
+/* op of a pattern instruction standing for Jcc */
+#define JCC (-2)
+
+typedef enum { ConstO, VarO, NegO, SumO, LabelO } OperandKind;
+
+typedef struct
+   { OperandKind kind ;
+     int a, b ;     /* the value, or variables */
+   } Operand;
+
+typedef struct
+   { int op ;
+     Operand r, s, t, d ;
+   } PeepInstr;
+
+typedef struct
+   { char * name ;
+     char * pattern [MAXWINDOW] ;
+     char * replace [MAXWINDOW] ;
+     int (* cond) (void) ;
+     /* the rule compiled, and how often it was used */
+     int npat, nrep ;
+     PeepInstr pat [MAXWINDOW] ;
+     PeepInstr rep [MAXWINDOW] ;
+     int count ;
+   } PeepRule;
+
+/* the bindings of a match: values of a..z, labels
+ * of A..Z, and the opcode of Jcc */
+static int val[26], bound[26];
+static int lab[26], labBound[26];
+static int jcc;
+
+#define V(c) val[(c) - 'a']
+
+/* the code, and the slots of the window; win[n]
+ * is the slot after it */
+static CodeBuf * cbuf;
+static int win[MAXWINDOW + 1];
+static int nwin;
+
+/* for each slot, the labels placed there; for each
+ * label, the instructions referring to it */
+static int * placed = NULL;
+static int * refs = NULL;
+
+/* slots seen while following the code, marked
+ * with the generation of the search */
+static int * seen = NULL;
+static int generation = 0;
+static int budget;
+
+/* reads tells whether instruction in reads reg */
+static int reads( CodeInstr * in, int reg)
+{ switch (in->op)
+  { case opOUT:
+      return in->r == reg;
+    case opADD: case opSUB: case opMUL: case opDIV:
+    case opVSUM:
+      return (in->s == reg) || (in->t == reg);
+    case opMCPY: case opMSET: case opVADD: case opVMUL:
+    case opVMIN: case opVMAX:
+      return (in->r == reg) || (in->s == reg) || (in->t == reg);
+    case opPUSH: case opST: case opCALL:
+    case opJLT: case opJLE: case opJGT: case opJGE: case opJEQ: case opJNE:
+      return (in->r == reg) || (in->s == reg);
+    case opPOP: case opRET: case opLD: case opLDA:
+      return in->s == reg;
+    default:
+      return FALSE;
+  }
+} /* reads */
+
+/* writes tells whether instruction in writes reg */
+static int writes( CodeInstr * in, int reg)
+{ switch (in->op)
+  { case opIN: case opADD: case opSUB: case opMUL: case opDIV:
+    case opVSUM: case opVMIN: case opVMAX:
+    case opLD: case opLDA: case opLDC: case opCALL:
+      return in->r == reg;
+    case opPOP:
+      return (in->r == reg) || (in->s == reg);
+    case opPUSH: case opRET:
+      return in->s == reg;
+    default:
+      return FALSE;
+  }
+} /* writes */
+
+/* liveAt tells whether the value of reg may be read
+ * by the code from slot loc on; TRUE when unsure
+ */
+static int liveAt( int reg, int loc)
+{ CodeInstr * in;
+  for (; loc < cbuf->size; loc++)
+  { if (--budget < 0) return TRUE;
+    if (seen[loc] == generation) return FALSE;
+    seen[loc] = generation;
+    in = &cbuf->instr[loc];
+    if (in->op == DELETED) continue;
+    if (reads(in,reg)) return TRUE;
+    if (in->op == opHALT) return FALSE;
+    /* a return */
+    if ((in->op == opRET) || ((in->op == opLD) && (in->r == pc)))
+      return (reg == ac) || (reg == mp) || (reg == gp);
+    if ((in->op >= opJLT) && (in->op <= opJNE))
+    { if (in->label < 0) return TRUE;
+      if (liveAt(reg,cbuf->labels[in->label])) return TRUE;
+      continue;
+    }
+    /* a jump, or a call: on to where it goes */
+    if (((in->op == opLDA) && (in->r == pc)) || (in->op == opCALL))
+    { if (in->label < 0) return TRUE;
+      loc = cbuf->labels[in->label] - 1;
+      continue;
+    }
+    if (writes(in,pc)) return TRUE;
+    if (writes(in,reg)) return FALSE;
+  }
+  return FALSE;
+} /* liveAt */
+
+/* live tells whether reg is live after the window */
+static int live( int reg)
+{ generation++;
+  budget = LIVEBUDGET;
+  return liveAt(reg,win[nwin]);
+}
+
+/* at tells whether label L is at window slot k */
+static int at( int L, int k)
+{ return cbuf->labels[lab[L - 'A']] == win[k]; }
+
+/* the conditions of the rules */
+static int aNotB(void)
+{ return V('a') != V('b'); }
+
+static int notPc(void)
+{ return V('a') != pc; }
+
+static int aUnused(void)
+{ return (V('a') == V('c')) || !live(V('a')); }
+
+static int tUnused(void)
+{ return (V('t') != V('s')) && ((V('t') == V('r')) || !live(V('t'))); }
+
+static int moveBack(void)
+{ return (V('a') != V('b')) && (V('a') != pc) && (V('b') != pc); }
+
+static int nextL(void)
+{ return at('L',1); }
+
+static int compare(void)
+{ return (V('r') != V('s')) && (V('r') != pc) && (V('s') != pc)
+         && at('T',4) && at('E',5) && !live(V('s'));
+}
+
+static int unused(void)
+{ return (V('a') != pc) && (V('a') != mp) && (V('a') != gp)
+         && !live(V('a'));
+}
+
+/* the fields of a rule compileRules fills in */
+#define UNCOMPILED 0, 0, {{0}}, {{0}}, 0
+
+/* the rules, tried in order at each instruction */
+static PeepRule rules[] =
+   { { "store then load",
+       {"ST a,x(b)", "LD c,x(b)"}, {"ST a,x(b)", "LDA c,0(a)"}, NULL,
+       UNCOMPILED },
+     { "load then store",
+       {"LD a,x(b)", "ST a,x(b)"}, {"LD a,x(b)"}, aNotB, UNCOMPILED },
+     { "move to itself",
+       {"LDA a,0(a)"}, {NULL}, NULL, UNCOMPILED },
+     { "constant then move",
+       {"LDC a,k(b)", "LDA c,0(a)"}, {"LDC c,k(0)"}, aUnused, UNCOMPILED },
+     { "add a constant",
+       {"LDC t,k(b)", "ADD r,s,t"}, {"LDA r,k(s)"}, tUnused, UNCOMPILED },
+     { "add a constant",
+       {"LDC t,k(b)", "ADD r,t,s"}, {"LDA r,k(s)"}, tUnused, UNCOMPILED },
+     { "subtract a constant",
+       {"LDC t,k(b)", "SUB r,s,t"}, {"LDA r,-k(s)"}, tUnused, UNCOMPILED },
+     { "add to an address",
+       {"LDA a,x(s)", "LDA a,y(a)"}, {"LDA a,x+y(s)"}, notPc, UNCOMPILED },
+     { "move back",
+       {"LDA a,0(b)", "LDA b,0(a)"}, {"LDA a,0(b)"}, moveBack, UNCOMPILED },
+     { "jump to the next",
+       {"LDA pc,L(pc)"}, {NULL}, nextL, UNCOMPILED },
+     { "branch to the next",
+       {"Jcc a,L(pc)"}, {NULL}, nextL, UNCOMPILED },
+     { "jump over one LDC",
+       {"SUB r,r,s", "Jcc r,T(pc)", "LDC r,0(a)", "LDA pc,E(pc)", "LDC r,1(b)"},
+       {"SUB s,r,s", "LDC r,1(0)", "Jcc s,E(pc)", "LDC r,0(0)"}, compare,
+       UNCOMPILED },
+     { "unused constant",
+       {"LDC a,k(b)"}, {NULL}, unused, UNCOMPILED },
+     { "unused address",
+       {"LDA a,x(b)"}, {NULL}, unused, UNCOMPILED }
+   };
+
+#define NRULES ((int) (sizeof(rules) / sizeof(rules[0])))
+
+/* opcode mnemonics, for reading the rules */
+static char * opCodeTab[] = TM_OPCODE_NAMES;
+
+/* Function parseOperand reads an operand of a rule
+ * at *s; FALSE if there is none
+ */
+static int parseOperand( char ** s, Operand * o)
+{ char * p = *s;
+  static struct { char * name; int reg; } names[] =
+     { {"pc",pc}, {"mp",mp}, {"gp",gp}, {"ac",ac} };
+  int i;
+  for (i = 0; i < 4; i++)
+    if ((strncmp(p,names[i].name,2) == 0) && !isalnum(p[2]))
+    { o->kind = ConstO;
+      o->a = names[i].reg;
+      *s = p + 2;
+      return TRUE;
+    }
+  if ((*p == '-') && islower(p[1]))
+  { o->kind = NegO;
+    o->a = p[1] - 'a';
+    p += 2;
+  }
+  else if ((*p == '-') || isdigit(*p))
+  { o->kind = ConstO;
+    o->a = (int) strtol(p,&p,10);
+  }
+  else if (islower(*p) && (p[1] == '+') && islower(p[2]))
+  { o->kind = SumO;
+    o->a = *p - 'a';
+    o->b = p[2] - 'a';
+    p += 3;
+  }
+  else if (islower(*p))
+  { o->kind = VarO;
+    o->a = *p++ - 'a';
+  }
+  else if (isupper(*p))
+  { o->kind = LabelO;
+    o->a = *p++ - 'A';
+  }
+  else return FALSE;
+  *s = p;
+  return TRUE;
+} /* parseOperand */
+
+/* Function parseInstr reads an instruction of a
+ * rule; FALSE if it is not right
+ */
+static int parseInstr( char * s, PeepInstr * in)
+{ char op[8];
+  int i = 0;
+  while ((*s != ' ') && (*s != '\0') && (i < 7)) op[i++] = *s++;
+  op[i] = '\0';
+  if (strcmp(op,"Jcc") == 0) in->op = JCC;
+  else
+  { for (in->op = 0; in->op < opRALim; in->op++)
+      if (strcmp(opCodeTab[in->op],op) == 0) break;
+    if (in->op == opRALim) return FALSE;
+  }
+  while (*s == ' ') s++;
+  in->t.kind = in->d.kind = ConstO;
+  in->t.a = in->d.a = 0;
+  if (!parseOperand(&s,&in->r) || (*s++ != ',')) return FALSE;
+  if ((in->op != JCC) && (in->op < opRRLim))
+    return parseOperand(&s,&in->s) && (*s++ == ',')
+           && parseOperand(&s,&in->t) && (*s == '\0');
+  return parseOperand(&s,&in->d) && (*s++ == '(')
+         && parseOperand(&s,&in->s) && (*s++ == ')') && (*s == '\0');
+} /* parseInstr */
+
+/* Procedure compileRules reads the rules, once */
+static void compileRules(void)
+{ static int done = FALSE;
+  PeepRule * rule;
+  int i;
+  if (done) return;
+  done = TRUE;
+  for (rule = rules; rule < rules + NRULES; rule++)
+  { for (i = 0; (i < MAXWINDOW) && (rule->pattern[i] != NULL); i++)
+      if (!parseInstr(rule->pattern[i],&rule->pat[i]))
+        fprintf(listing,"BUG: peephole rule %s: %s\n",rule->name,
+                rule->pattern[i]);
+    rule->npat = i;
+    for (i = 0; (i < MAXWINDOW) && (rule->replace[i] != NULL); i++)
+      if (!parseInstr(rule->replace[i],&rule->rep[i]))
+        fprintf(listing,"BUG: peephole rule %s: %s\n",rule->name,
+                rule->replace[i]);
+    rule->nrep = i;
+  }
+} /* compileRules */
+
+/* matchOperand matches operand o with value v */
+static int matchOperand( Operand * o, int v)
+{ if (o->kind == ConstO) return o->a == v;
+  if (bound[o->a]) return val[o->a] == v;
+  bound[o->a] = TRUE;
+  val[o->a] = v;
+  return TRUE;
+} /* matchOperand */
+
+/* matchInstr matches instruction in with p */
+static int matchInstr( PeepInstr * p, CodeInstr * in)
+{ if (p->op == JCC)
+  { if ((in->op < opJLT) || (in->op > opJNE)) return FALSE;
+    if ((jcc >= 0) && (jcc != in->op)) return FALSE;
+    jcc = in->op;
+  }
+  else if (p->op != in->op) return FALSE;
+  if (!matchOperand(&p->r,in->r) || !matchOperand(&p->s,in->s))
+    return FALSE;
+  if (in->op < opRRLim) return matchOperand(&p->t,in->t);
+  if (p->d.kind != LabelO)
+    return (in->label < 0) && matchOperand(&p->d,in->d);
+  if (in->label < 0) return FALSE;
+  if (labBound[p->d.a]) return lab[p->d.a] == in->label;
+  labBound[p->d.a] = TRUE;
+  lab[p->d.a] = in->label;
+  return TRUE;
+} /* matchInstr */
+
+/* value gives the value of operand o */
+static int value( Operand * o)
+{ switch (o->kind)
+  { case NegO:
+      return (int) (0u - (unsigned) val[o->a]);
+    case SumO:
+      return (int) ((unsigned) val[o->a] + (unsigned) val[o->b]);
+    case VarO:
+      return val[o->a];
+    default:
+      return o->a;
+  }
+} /* value */
+
+/* Function window finds the slots of the n
+ * instructions from slot loc on; FALSE if the
+ * code ends first
+ */
+static int window( int loc, int n)
+{ int k;
+  for (k = 0; k <= n; k++)
+  { while ((loc < cbuf->size) && (cbuf->instr[loc].op == DELETED)) loc++;
+    if ((loc == cbuf->size) && (k < n)) return FALSE;
+    win[k] = loc++;
+  }
+  nwin = n;
+  return TRUE;
+} /* window */
+
+/* Function ownLabels tells whether the labels
+ * placed inside the window are all of the
+ * pattern, with no references from outside it
+ */
+static int ownLabels(void)
+{ int k, j, L, mine, uses;
+  for (k = 1; k < nwin; k++)
+  { if (placed[win[k]] == 0) continue;
+    mine = 0;
+    for (L = 0; L < 26; L++)
+    { if (!labBound[L] || (cbuf->labels[lab[L]] != win[k])) continue;
+      for (j = 0; j < L; j++)
+        if (labBound[j] && (lab[j] == lab[L])) break;
+      if (j < L) continue;
+      for (uses = 0, j = 0; j < nwin; j++)
+        if (cbuf->instr[win[j]].label == lab[L]) uses++;
+      if (uses != refs[lab[L]]) return FALSE;
+      mine++;
+    }
+    if (mine != placed[win[k]]) return FALSE;
+  }
+  return TRUE;
+} /* ownLabels */
+
+/* Function tryRule tries rule on the window from
+ * slot loc, and makes the replacement if it
+ * matches
+ */
+static int tryRule( PeepRule * rule, int loc)
+{ CodeInstr * in, old[MAXWINDOW];
+  PeepInstr * p;
+  int k, L;
+  if (!window(loc,rule->npat)) return FALSE;
+  for (k = 0; k < 26; k++) bound[k] = labBound[k] = FALSE;
+  jcc = -1;
+  for (k = 0; k < nwin; k++)
+    if (!matchInstr(&rule->pat[k],&cbuf->instr[win[k]])) return FALSE;
+  if (!ownLabels()) return FALSE;
+  if ((rule->cond != NULL) && !rule->cond()) return FALSE;
+  /* replace */
+  for (k = 0; k < nwin; k++)
+  { old[k] = cbuf->instr[win[k]];
+    if (old[k].label >= 0) refs[old[k].label]--;
+  }
+  for (k = 0; k < rule->nrep; k++)
+  { p = &rule->rep[k];
+    in = &cbuf->instr[win[k]];
+    *in = old[k];
+    in->op = (p->op == JCC) ? jcc : p->op;
+    in->r = value(&p->r);
+    in->s = value(&p->s);
+    in->t = value(&p->t);
+    if (p->d.kind == LabelO)
+    { in->label = lab[p->d.a];
+      in->d = 0;
+      refs[in->label]++;
+    }
+    else
+    { in->label = -1;
+      in->d = value(&p->d);
+    }
+    if (TraceCode) in->comment = rule->name;
+  }
+  for (; k < nwin; k++)
+  { cbuf->instr[win[k]].op = DELETED;
+    if (placed[win[k]] == 0) continue;
+    /* its labels move on to the next instruction */
+    for (L = 0; L < cbuf->nlabels; L++)
+      if (cbuf->labels[L] == win[k]) cbuf->labels[L] = win[nwin];
+    placed[win[nwin]] += placed[win[k]];
+    placed[win[k]] = 0;
+  }
+  rule->count++;
+  return TRUE;
+} /* tryRule */
+
+/* Procedure peephole is a code pass: it slides a
+ * window over the instructions and replaces the
+ * sequences its rules match with shorter ones,
+ * until none match
+ */
+void peephole( CodeBuf * buf )
+{ int loc, L, sweep, changed, n;
+  PeepRule * rule;
+  compileRules();
+  cbuf = buf;
+  placed = (int *) calloc(buf->size + 1,sizeof(int));
+  refs = (int *) calloc(buf->nlabels + 1,sizeof(int));
+  seen = (int *) calloc(buf->size + 1,sizeof(int));
+  if ((placed == NULL) || (refs == NULL) || (seen == NULL))
+  { fprintf(listing,"Out of memory for the peephole optimizer\n");
+    exit(1);
+  }
+  generation = 0;
+  for (L = 0; L < buf->nlabels; L++)
+    if (buf->labels[L] >= 0) placed[buf->labels[L]]++;
+  for (loc = 0; loc < buf->size; loc++)
+    if (buf->instr[loc].label >= 0) refs[buf->instr[loc].label]++;
+  for (sweep = 0, changed = TRUE; changed && (sweep < MAXSWEEPS); sweep++)
+  { changed = FALSE;
+    for (loc = 0; loc < buf->size; loc++)
+    { if (buf->instr[loc].op == DELETED) continue;
+      for (n = 0; n < NRULES; n++)
+        if (tryRule(&rules[n],loc))
+        { changed = TRUE;
+          /* try again here, unless it has gone */
+          if (buf->instr[loc].op == DELETED) break;
+          n = -1;
+        }
+    }
+  }
+  if (TraceCode)
+    for (rule = rules; rule < rules + NRULES; rule++)
+      if (rule->count > 0)
+        fprintf(listing,"Peephole: %s %d\n",rule->name,rule->count);
+  free(placed);
+  free(refs);
+  free(seen);
+} /* peephole */
@@ -0,0 +1,22 @@
+/****************************************************/
+/* File: peephole.h                                 */
+/* Peephole optimizer for the TM code of the        */
+/* C-MINUS compiler                                 */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _PEEPHOLE_H_
+#define _PEEPHOLE_H_
+
+#include "code.h"
+
+/* Procedure peephole is a code pass (see code.h):
+ * it slides a window over the instructions and
+ * replaces the sequences its rules match with
+ * shorter ones, until none match. If TraceCode is
+ * TRUE it lists how often each rule was used.
+ */
+void peephole( CodeBuf * buf );
+
+#endif
@@ -1,6 +1,7 @@
 /****************************************************/
 /* File: tm.c                                       */
 /* The TM ("Tiny Machine") computer                 */
+/* Command line interface to the TM library         */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
@@ -9,417 +10,460 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-
-#ifndef TRUE
-#define TRUE 1
-#endif
-#ifndef FALSE
-#define FALSE 0
-#endif
+#include <time.h>
+#include <unistd.h>
+#include "tmvm.h"
+#include "tmpar.h"
+#include "tmprof.h"
+#include "tmtrace.h"
+#include "tmrev.h"
+#include "tmbreak.h"
 
 /******* const *******/
-#define   IADDR_SIZE  1024 /* increase for large programs */
-#define   DADDR_SIZE  1024 /* increase for large programs */
-#define   NO_REGS 8
-#define   PC_REG  7
-
-#define   LINESIZE  121
-#define   WORDSIZE  20
-
-/******* type  *******/
-
-typedef enum {
-   opclRR,     /* reg operands r,s,t */
-   opclRM,     /* reg r, mem d+s */
-   opclRA      /* reg r, int d+s */
-   } OPCLASS;
-
-typedef enum {
-   /* RR instructions */
-   opHALT,    /* RR     halt, operands are ignored */
-   opIN,      /* RR     read into reg(r); s and t are ignored */
-   opOUT,     /* RR     write from reg(r), s and t are ignored */
-   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
-   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
-   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
-   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
-   opRRLim,   /* limit of RR opcodes */
-
-   /* RM instructions */
-   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
-   opST,      /* RM     mem(d+reg(s)) = reg(r) */
-   opRMLim,   /* Limit of RM opcodes */
-
-   /* RA instructions */
-   opLDA,     /* RA     reg(r) = d+reg(s) */
-   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
-   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
-   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
-   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
-   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
-   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
-   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
-   opRALim    /* Limit of RA opcodes */
-   } OPCODE;
-
-typedef enum {
-   srOKAY,
-   srHALT,
-   srIMEM_ERR,
-   srDMEM_ERR,
-   srZERODIVIDE
-   } STEPRESULT;
-
-typedef struct {
-      int iop  ;
-      int iarg1  ;
-      int iarg2  ;
-      int iarg3  ;
-   } INSTRUCTION;
+#define   OUTBUFSIZE  65536 /* batch mode output buffer */
 
 /******** vars ********/
 int iloc = 0 ;
 int dloc = 0 ;
 int traceflag = FALSE;
 int icountflag = FALSE;
+int revflag = FALSE; /* keep the history for S and G (u) */
+
+TMState * tm ;
+
+/* batch mode: IN takes the values read in advance
+ * by readValues, and OUT appends to outBuf, which
+ * is written to outFile in bulk
+ */
+int batchflag = FALSE;
+int binaryflag = FALSE;
+FILE * outFile = NULL;
+char outBuf[OUTBUFSIZE];
+int outLen = 0;
+
+/* multi-input mode: the program is run once for
+ * each line of a file of input sets, by nthreads
+ * threads (default: one per processor)
+ */
+int nthreads = 0;
+
+/* fork server (-k): -m runs in child processes
+ * forked at the first IN, instead of threads
+ */
+int forkflag = FALSE;
+
+char pgmName[120];
+
+/* profiling: counts are written to profName */
+char * profName = NULL;
 
-INSTRUCTION iMem [IADDR_SIZE];
-int dMem [DADDR_SIZE];
-int reg [NO_REGS];
-
-char * opCodeTab[]
-        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV","????",
-            /* RR opcodes */
-           "LD","ST","????", /* RM opcodes */
-           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
-           /* RA opcodes */
-          };
-
-char * stepResultTab[]
-        = {"OK","Halted","Instruction Memory Fault",
-           "Data Memory Fault","Division by 0"
-          };
-
-char pgmName[20];
-FILE *pgm  ;
-
-char in_Line[LINESIZE] ;
-int lineLen ;
-int inCol  ;
-int num  ;
-char word[WORDSIZE] ;
-char ch  ;
+/* binary trace (tmdecode reads it) */
+char * traceName = NULL;
+FILE * traceFile = NULL;
+
+TMLine cmdLine ;
 int done  ;
 
 /********************************************/
-int opClass( int c )
-{ if      ( c <= opRRLim) return ( opclRR );
-  else if ( c <= opRMLim) return ( opclRM );
-  else                    return ( opclRA );
-} /* opClass */
+/* askValue is the interactive IN: it prompts
+ * until it gets a number, or stdin runs out
+ */
+int askValue (TMState * tm, int * value)
+{ char buf[LINESIZE];
+  TMLine line;
+  int ok ;
+  do
+  { printf("Enter value for IN instruction: ") ;
+    fflush (stdout);
+    if (fgets(buf,LINESIZE,stdin) == NULL) return FALSE;
+    tm_set_line(&line,buf);
+    ok = tm_get_num(&line);
+    if ( ! ok ) printf ("Illegal value\n");
+    else *value = line.num;
+  }
+  while (! ok);
+  return TRUE;
+} /* askValue */
 
 /********************************************/
-void writeInstruction ( int loc )
-{ printf( "%5d: ", loc) ;
-  if ( (loc >= 0) && (loc < IADDR_SIZE) )
-  { printf("%6s%3d,", opCodeTab[iMem[loc].iop], iMem[loc].iarg1);
-    switch ( opClass(iMem[loc].iop) )
-    { case opclRR: printf("%1d,%1d", iMem[loc].iarg2, iMem[loc].iarg3);
-                   break;
-      case opclRM:
-      case opclRA: printf("%3d(%1d)", iMem[loc].iarg2, iMem[loc].iarg3);
-                   break;
+void printValue (TMState * tm, int v)
+{ printf ("OUT instruction prints: %d\n", v ) ;
+} /* printValue */
+
+/********************************************/
+/* writeHalt reports the HALT instruction
+ * that ended the run
+ */
+void writeHalt (void)
+{ INSTRUCTION * in = &tm->pgm->iMem[tm->iloc] ;
+  printf("HALT: %1d,%1d,%1d\n",in->iarg1,in->iarg2,in->iarg3);
+} /* writeHalt */
+
+/********************************************/
+/* readValues reads all of the input for a batch
+ * run at once: whitespace separated integers
+ * from the named file, or stdin if name is NULL
+ */
+int readValues (char * name)
+{ FILE * in = stdin;
+  char * text, * p, * end;
+  size_t len = 0, cap = 65536, n;
+  int * vals;
+  int cnt = 0;
+  if ( (name != NULL) && ((in = fopen(name,"r")) == NULL) )
+  { fprintf(stderr,"input file '%s' not found\n",name);
+    return FALSE;
+  }
+  text = (char *) malloc(cap + 1);
+  while ( (n = fread(text + len,1,cap - len,in)) > 0 )
+  { len += n;
+    if (len == cap) text = (char *) realloc(text,(cap *= 2) + 1);
+  }
+  text[len] = '\0';
+  if (in != stdin) fclose(in);
+  /* every value takes at least two characters */
+  vals = (int *) malloc((len / 2 + 1) * sizeof(int));
+  p = text;
+  while (TRUE)
+  { while (isspace((unsigned char) *p)) p++;
+    if (*p == '\0') break;
+    vals[cnt] = (int) strtol(p,&end,10);
+    if ( (end == p) || ((*end != '\0') && ! isspace((unsigned char) *end)) )
+    { fprintf(stderr,"illegal input value after %d values\n",cnt);
+      free(text);
+      return FALSE;
     }
-    printf ("\n") ;
+    cnt++;
+    p = end;
   }
-} /* writeInstruction */
+  free(text);
+  tm_set_input(tm,vals,cnt);
+  return TRUE;
+} /* readValues */
 
 /********************************************/
-void getCh (void)
-{ if (++inCol < lineLen)
-  ch = in_Line[inCol] ;
-  else ch = ' ' ;
-} /* getCh */
+void flushValues (void)
+{ if (outLen > 0) fwrite(outBuf,1,outLen,outFile);
+  outLen = 0;
+} /* flushValues */
 
 /********************************************/
-int nonBlank (void)
-{ while ((inCol < lineLen)
-         && (in_Line[inCol] == ' ') )
-    inCol++ ;
-  if (inCol < lineLen)
-  { ch = in_Line[inCol] ;
-    return TRUE ; }
-  else
-  { ch = ' ' ;
-    return FALSE ; }
-} /* nonBlank */
+/* putValue appends v to the batch output, as a
+ * decimal line or as a packed binary int
+ */
+void putValue (TMState * tm, int v)
+{ char digits[12];
+  unsigned int u;
+  int n = 0;
+  if (outLen > OUTBUFSIZE - 16) flushValues();
+  if (binaryflag)
+  { memcpy(outBuf + outLen,&v,sizeof(int));
+    outLen += sizeof(int);
+    return;
+  }
+  if (v < 0)
+  { outBuf[outLen++] = '-';
+    u = - (unsigned int) v;
+  }
+  else u = v;
+  do
+  { digits[n++] = '0' + u % 10;
+    u /= 10;
+  } while (u != 0);
+  while (n > 0) outBuf[outLen++] = digits[--n];
+  outBuf[outLen++] = '\n';
+} /* putValue */
 
 /********************************************/
-int getNum (void)
-{ int sign;
-  int term;
-  int temp = FALSE;
-  num = 0 ;
-  do
-  { sign = 1;
-    while ( nonBlank() && ((ch == '+') || (ch == '-')) )
-    { temp = FALSE ;
-      if (ch == '-')  sign = - sign ;
-      getCh();
+/* readSets reads a file of input sets, one line
+ * of whitespace separated integers per set, into
+ * a new array of *n jobs; NULL on error
+ */
+TMJob * readSets (char * name, int * n)
+{ FILE * in;
+  TMJob * jobs = NULL;
+  char * line = NULL, * p, * end;
+  size_t lineCap = 0;
+  int cnt = 0, cap = 0, vcnt;
+  if ((in = fopen(name,"r")) == NULL)
+  { fprintf(stderr,"input file '%s' not found\n",name);
+    return NULL;
+  }
+  while (getline(&line,&lineCap,in) != -1)
+  { if (cnt == cap)
+    { cap = cap ? 2 * cap : 1024;
+      jobs = (TMJob *) realloc(jobs,cap * sizeof(TMJob));
     }
-    term = 0 ;
-    nonBlank();
-    while (isdigit(ch))
-    { temp = TRUE ;
-      term = term * 10 + ( ch - '0' ) ;
-      getCh();
+    /* every value takes at least two characters */
+    jobs[cnt].inVals = (int *) malloc((strlen(line) / 2 + 1) * sizeof(int));
+    vcnt = 0;
+    p = line;
+    while (TRUE)
+    { while (isspace((unsigned char) *p)) p++;
+      if (*p == '\0') break;
+      jobs[cnt].inVals[vcnt] = (int) strtol(p,&end,10);
+      if ( (end == p) || ((*end != '\0') && ! isspace((unsigned char) *end)) )
+      { fprintf(stderr,"illegal input value in set %d\n",cnt + 1);
+        free(line);
+        fclose(in);
+        return NULL;
+      }
+      vcnt++;
+      p = end;
     }
-    num = num + (term * sign) ;
-  } while ( (nonBlank()) && ((ch == '+') || (ch == '-')) ) ;
-  return temp;
-} /* getNum */
+    jobs[cnt++].inCount = vcnt;
+  }
+  free(line);
+  fclose(in);
+  *n = cnt;
+  return jobs;
+} /* readSets */
 
 /********************************************/
-int getWord (void)
-{ int temp = FALSE;
-  int length = 0;
-  if (nonBlank ())
-  { while (isalnum(ch))
-    { if (length < WORDSIZE-1) word [length++] =  ch ;
-      getCh() ;
+/* runSets runs every input set of setsName and
+ * writes one line per set, in the order of the
+ * sets: its OUT values, then the step result if
+ * the run did not halt. Returns the exit status:
+ * 0 if every run halted.
+ */
+int runSets (char * setsName, char * outName)
+{ TMJob * jobs;
+  int n, i, k, status = 0;
+  if ((jobs = readSets(setsName,&n)) == NULL)
+    return 1;
+  if (nthreads <= 0)
+    nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if ( forkflag ? ! tm_fork_jobs(tm,jobs,n,nthreads)
+                : ! tm_run_jobs(tm,jobs,n,nthreads) )
+  { fprintf(stderr,"cannot start the runs\n");
+    return 1;
+  }
+  outFile = stdout;
+  if ( (outName != NULL) && ((outFile = fopen(outName,"w")) == NULL) )
+  { fprintf(stderr,"cannot create '%s'\n",outName);
+    return 1;
+  }
+  for (i = 0; i < n; i++)
+  { for (k = 0; k < jobs[i].outCount; k++)
+      fprintf(outFile,k ? " %d" : "%d",jobs[i].outVals[k]);
+    if (jobs[i].result != srHALT)
+    { fprintf(outFile,"%s# %s at location %d after %d instructions",
+              jobs[i].outCount ? " " : "",stepResultTab[jobs[i].result],
+              jobs[i].iloc,jobs[i].icount);
+      status = 1;
     }
-    word[length] = '\0';
-    temp = (length != 0);
+    fputc('\n',outFile);
+    free(jobs[i].inVals);
+    free(jobs[i].outVals);
   }
-  return temp;
-} /* getWord */
+  free(jobs);
+  if (fclose(outFile) != 0)
+  { fprintf(stderr,"error writing batch output\n");
+    return 1;
+  }
+  return status;
+} /* runSets */
 
 /********************************************/
-int skipCh ( char c  )
-{ int temp = FALSE;
-  if ( nonBlank() && (ch == c) )
-  { getCh();
-    temp = TRUE;
+/* writeProfile reports the profile on out, by
+ * source line if the compiler left a line table
+ * (.tml) next to the program, and writes the
+ * counts to profName
+ */
+int writeProfile (FILE * out)
+{ char lineName[124];
+  char * dot;
+  FILE * data;
+  int ok;
+  strcpy(lineName,pgmName);
+  dot = strrchr(lineName,'.');
+  if ( (dot != NULL) && (strchr(dot,'/') == NULL) ) *dot = '\0';
+  strcat(lineName,".tml");
+  data = fopen(profName,"w");
+  if (data == NULL)
+  { fprintf(stderr,"cannot create '%s'\n",profName);
+    return FALSE;
   }
-  return temp;
-} /* skipCh */
+  ok = tm_profile_report(tm,out,lineName,data);
+  if (fclose(data) != 0) ok = FALSE;
+  if (! ok) fprintf(stderr,"error writing '%s'\n",profName);
+  return ok;
+} /* writeProfile */
 
 /********************************************/
-int atEOL(void)
-{ return ( ! nonBlank ());
-} /* atEOL */
+/* endTrace writes the rest of the binary trace */
+int endTrace (void)
+{ int ok;
+  if (traceFile == NULL) return TRUE;
+  ok = tm_trace_stop(tm);
+  if (fclose(traceFile) != 0) ok = FALSE;
+  traceFile = NULL;
+  if (! ok) fprintf(stderr,"error writing '%s'\n",traceName);
+  return ok;
+} /* endTrace */
 
 /********************************************/
-int error( char * msg, int lineNo, int instNo)
-{ printf("Line %d",lineNo);
-  if (instNo >= 0) printf(" (Instruction %d)",instNo);
-  printf("   %s\n",msg);
-  return FALSE;
-} /* error */
+int isCSource (char * name)
+{ int len = strlen(name);
+  return (len > 2) && (strcmp(name + len - 2,".c") == 0);
+} /* isCSource */
 
 /********************************************/
-int readInstructions (void)
-{ OPCODE op;
-  int arg1, arg2, arg3;
-  int loc, regNo, lineNo;
-  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
-      reg[regNo] = 0 ;
-  dMem[0] = DADDR_SIZE - 1 ;
-  for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-      dMem[loc] = 0 ;
-  for (loc = 0 ; loc < IADDR_SIZE ; loc++)
-  { iMem[loc].iop = opHALT ;
-    iMem[loc].iarg1 = 0 ;
-    iMem[loc].iarg2 = 0 ;
-    iMem[loc].iarg3 = 0 ;
-  }
-  lineNo = 0 ;
-  while (! feof(pgm))
-  { fgets( in_Line, LINESIZE-2, pgm  ) ;
-    inCol = 0 ; 
-    lineNo++;
-    lineLen = strlen(in_Line)-1 ;
-    if (in_Line[lineLen]=='\n') in_Line[lineLen] = '\0' ;
-    else in_Line[++lineLen] = '\0';
-    if ( (nonBlank()) && (in_Line[inCol] != '*') )
-    { if (! getNum())
-        return error("Bad location", lineNo,-1);
-      loc = num;
-      if (loc > IADDR_SIZE)
-        return error("Location too large",lineNo,loc);
-      if (! skipCh(':'))
-        return error("Missing colon", lineNo,loc);
-      if (! getWord ())
-        return error("Missing opcode", lineNo,loc);
-      op = opHALT ;
-      while ((op < opRALim)
-             && (strncmp(opCodeTab[op], word, 4) != 0) )
-          op++ ;
-      if (strncmp(opCodeTab[op], word, 4) != 0)
-          return error("Illegal opcode", lineNo,loc);
-      switch ( opClass(op) )
-      { case opclRR :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo, loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad second register", lineNo, loc);
-        arg2 = num;
-        if ( ! skipCh(',')) 
-            return error("Missing comma", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad third register", lineNo,loc);
-        arg3 = num;
-        break;
+/* nextEngine gives the engine after e that
+ * this build has
+ */
+ENGINE nextEngine (ENGINE e)
+{ do
+    e = (e == engJIT) ? engSWITCH : e + 1;
+  while ( ( (e == engTHREADED) && ! HAVE_THREADED )
+          || ( (e == engJIT) && ! HAVE_JIT ) );
+  return e;
+} /* nextEngine */
 
-        case opclRM :
-        case opclRA :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo,loc);
-        if (! getNum ())
-            return error("Bad displacement", lineNo,loc);
-        arg2 = num;
-        if ( ! skipCh('(') && ! skipCh(',') )
-            return error("Missing LParen", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS))
-            return error("Bad second register", lineNo,loc);
-        arg3 = num;
-        break;
-        }
-      iMem[loc].iop = op;
-      iMem[loc].iarg1 = arg1;
-      iMem[loc].iarg2 = arg2;
-      iMem[loc].iarg3 = arg3;
+/********************************************/
+/* goTM executes until the result is not
+ * srOKAY; *icount gets the number of steps.
+ * Tracing needs the per-step loop, which stops
+ * at breakpoints after the first step and at
+ * the limits as tm_run does.
+ */
+STEPRESULT goTM (int * icount)
+{ STEPRESULT stepResult = srOKAY;
+  int stepcnt = 0;
+  if ( ! traceflag )
+    return tm_run (tm,icount);
+  tm_limit_start (tm);
+  while (stepResult == srOKAY)
+  { iloc = tm->reg[PC_REG] ;
+    if ( (stepcnt > 0) && tm_break_at (tm,iloc) )
+    { tm->iloc = iloc ;
+      stepResult = srBREAK ;
+    }
+    else if ( (stepcnt >= tm->nextCheck) && tm_limit (tm,stepcnt) )
+    { tm->iloc = iloc ;
+      stepResult = srLIMIT ;
+    }
+    else
+    { tm_write_instruction( tm, stdout, iloc ) ;
+      stepResult = tm_step (tm);
+      stepcnt++;
     }
   }
-  return TRUE;
-} /* readInstructions */
-
+  *icount = stepcnt;
+  return stepResult;
+} /* goTM */
 
 /********************************************/
-STEPRESULT stepTM (void)
-{ INSTRUCTION currentinstruction  ;
-  int pc  ;
-  int r,s,t,m  ;
-  int ok ;
+int doCommand (void)
+{ char cmd;
+  char buf[LINESIZE];
+  int stepcnt=0, i;
+  long back;
+  int printcnt;
+  int stepResult;
+  ENGINE used;
+  clock_t startTime;
+  double seconds;
+  do
+  { printf ("Enter command: ");
+    fflush (stdout);
+    if (fgets(buf,LINESIZE,stdin) == NULL) return FALSE;
+    tm_set_line(&cmdLine,buf);
+  }
+  while (! tm_get_word (&cmdLine));
 
-  pc = reg[PC_REG] ;
-  if ( (pc < 0) || (pc > IADDR_SIZE)  )
-      return srIMEM_ERR ;
-  reg[PC_REG] = pc + 1 ;
-  currentinstruction = iMem[ pc ] ;
-  switch (opClass(currentinstruction.iop) )
-  { case opclRR :
+  cmd = cmdLine.word[0] ;
+  switch ( cmd )
+  { case 't' :
     /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg2 ;
-      t = currentinstruction.iarg3 ;
+      traceflag = ! traceflag ;
+      printf("Tracing now ");
+      if ( traceflag ) printf("on.\n"); else printf("off.\n");
       break;
 
-    case opclRM :
+    case 'e' :
     /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg3 ;
-      m = currentinstruction.iarg2 + reg[s] ;
-      if ( (m < 0) || (m > DADDR_SIZE))
-         return srDMEM_ERR ;
+      tm->engine = nextEngine (tm->engine);
+      printf("Engine for 'go' is now %s.\n",engineTab[tm->engine]);
       break;
 
-    case opclRA :
+    case 'v' :
     /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg3 ;
-      m = currentinstruction.iarg2 + reg[s] ;
+      tm->jitCheck = ! tm->jitCheck ;
+      printf("Checking of JIT code against the interpreter now ");
+      if ( tm->jitCheck ) printf("on.\n"); else printf("off.\n");
       break;
-  } /* case */
-
-  switch ( currentinstruction.iop)
-  { /* RR instructions */
-    case opHALT :
-    /***********************************/
-      printf("HALT: %1d,%1d,%1d\n",r,s,t);
-      return srHALT ;
-      /* break; */
 
-    case opIN :
+    case 'b' :
     /***********************************/
-      do
-      { printf("Enter value for IN instruction: ") ;
-        fflush (stdin);
-        fflush (stdout);
-        gets(in_Line);
-        lineLen = strlen(in_Line) ;
-        inCol = 0;
-        ok = getNum();
-        if ( ! ok ) printf ("Illegal value\n");
-        else reg[r] = num;
+      if ( tm_at_eol (&cmdLine))
+      { printf("Breakpoints:");
+        for (i = 0; i < tm->pgm->iMemSize; i++)
+          if ( tm_break_at (tm,i) ) printf(" %d",i);
+        printf("\n");
       }
-      while (! ok);
+      else if ( ! tm_get_num (&cmdLine) || ! tm_at_eol (&cmdLine) )
+        printf("Instruction location?\n");
+      else if ( ! tm_break_set (tm,cmdLine.num,! tm_break_at (tm,cmdLine.num)) )
+        printf("No breakpoint possible at %d.\n",cmdLine.num);
+      else
+        printf("Breakpoint at %d now %s.\n",cmdLine.num,
+               tm_break_at (tm,cmdLine.num) ? "on" : "off");
       break;
 
-    case opOUT :  
-      printf ("OUT instruction prints: %d\n", reg[r] ) ;
+    case 'w' :
+    /***********************************/
+      if ( tm_at_eol (&cmdLine))
+      { printf("Watchpoints:");
+        for (i = 0; (tm->watch != NULL) && (i < tm->dSize); i++)
+          if ( tm->watch->bits[i >> 3] == 0 ) i |= 7;
+          else if ( tm_watch_at (tm,i) ) printf(" %d",i);
+        printf("\n");
+      }
+      else if ( ! tm_get_num (&cmdLine) || ! tm_at_eol (&cmdLine) )
+        printf("Data location?\n");
+      else if ( ! tm_watch_set (tm,cmdLine.num,! tm_watch_at (tm,cmdLine.num)) )
+        printf("No watchpoint possible on %d.\n",cmdLine.num);
+      else
+        printf("Watchpoint on %d now %s.\n",cmdLine.num,
+               tm_watch_at (tm,cmdLine.num) ? "on" : "off");
       break;
-    case opADD :  reg[r] = reg[s] + reg[t] ;  break;
-    case opSUB :  reg[r] = reg[s] - reg[t] ;  break;
-    case opMUL :  reg[r] = reg[s] * reg[t] ;  break;
 
-    case opDIV :
+    case 'u' :
     /***********************************/
-      if ( reg[t] != 0 ) reg[r] = reg[s] / reg[t];
-      else return srZERODIVIDE ;
+      revflag = ! revflag ;
+      if ( ! revflag ) tm_rev_stop (tm);
+      else if ( ! tm_rev_start (tm) )
+      { printf("Out of memory for the history.\n");
+        revflag = FALSE;
+      }
+      printf("Recording of the history now ");
+      if ( revflag ) printf("on.\n"); else printf("off.\n");
       break;
 
-    /*************** RM instructions ********************/
-    case opLD :    reg[r] = dMem[m] ;  break;
-    case opST :    dMem[m] = reg[r] ;  break;
-
-    /*************** RA instructions ********************/
-    case opLDA :    reg[r] = m ; break;
-    case opLDC :    reg[r] = currentinstruction.iarg2 ;   break;
-    case opJLT :    if ( reg[r] <  0 ) reg[PC_REG] = m ; break;
-    case opJLE :    if ( reg[r] <=  0 ) reg[PC_REG] = m ; break;
-    case opJGT :    if ( reg[r] >  0 ) reg[PC_REG] = m ; break;
-    case opJGE :    if ( reg[r] >=  0 ) reg[PC_REG] = m ; break;
-    case opJEQ :    if ( reg[r] == 0 ) reg[PC_REG] = m ; break;
-    case opJNE :    if ( reg[r] != 0 ) reg[PC_REG] = m ; break;
-
-    /* end of legal instructions */
-  } /* case */
-  return srOKAY ;
-} /* stepTM */
-
-/********************************************/
-int doCommand (void)
-{ char cmd;
-  int stepcnt=0, i;
-  int printcnt;
-  int stepResult;
-  int regNo, loc;
-  do
-  { printf ("Enter command: ");
-    fflush (stdin);
-    fflush (stdout);
-    gets(in_Line);
-    lineLen = strlen(in_Line);
-    inCol = 0;
-  }
-  while (! getWord ());
-
-  cmd = word[0] ;
-  switch ( cmd )
-  { case 't' :
+    case 'S' :
+    case 'G' :
     /***********************************/
-      traceflag = ! traceflag ;
-      printf("Tracing now ");
-      if ( traceflag ) printf("on.\n"); else printf("off.\n");
+      if ( tm->rev == NULL )
+      { printf("No history is being recorded (see u).\n");
+        break;
+      }
+      if ( ! tm_get_num (&cmdLine) ) i = (cmd == 'S') ? 1 : -1;
+      else if ( cmd == 'S' ) i = abs(cmdLine.num);
+      else i = cmdLine.num;
+      if ( ! tm_at_eol (&cmdLine) )
+      { printf(cmd == 'S' ? "Step count?\n" : "Instruction location?\n");
+        break;
+      }
+      back = tm->rev->steps;
+      if ( cmd == 'S' ) tm_rev_step (tm,i);
+      else if ( ! tm_rev_continue (tm,i) )
+      { printf("Location %d not reached.\n",i);
+        break;
+      }
+      back -= tm->rev->steps;
+      printf("Back %ld steps, at step %ld:\n",back,tm->rev->steps);
+      tm_write_instruction(tm,stdout,tm->reg[PC_REG]);
       break;
 
     case 'h' :
@@ -429,6 +473,20 @@ int doCommand (void)
              "Execute n (default 1) TM instructions\n");
       printf("   g(o            "\
              "Execute TM instructions until HALT\n");
+      printf("   S(tep back <n> "\
+             "Go back n (default 1) TM instructions\n");
+      printf("   G(o back <b>   "\
+             "Go back to the last time the pc was b"\
+             " (default: to the start)\n");
+      printf("   u(ndo          "\
+             "Toggle recording of the history for S and G"\
+             " (off at first; when on, 'go' uses the switch engine)\n");
+      printf("   b(reak <b>     "\
+             "Toggle the breakpoint at iMem b ('go' stops there),"\
+             " or list them\n");
+      printf("   w(atch <b>     "\
+             "Toggle the watchpoint on dMem b ('go' stops after"\
+             " a store there), or list them\n");
       printf("   r(egs          "\
              "Print the contents of the registers\n");
       printf("   i(Mem <b <n>>  "\
@@ -440,6 +498,10 @@ int doCommand (void)
       printf("   p(rint         "\
              "Toggle print of total instructions executed"\
              " ('go' only)\n");
+      printf("   e(ngine        "\
+             "Cycle switch/threaded/jit execution ('go' only)\n");
+      printf("   v(erify        "\
+             "Toggle checking of JIT code against the interpreter\n");
       printf("   c(lear         "\
              "Reset simulator for new execution of program\n");
       printf("   h(elp          "\
@@ -457,8 +519,8 @@ int doCommand (void)
 
     case 's' :
     /***********************************/
-      if ( atEOL ())  stepcnt = 1;
-      else if ( getNum ())  stepcnt = abs(num);
+      if ( tm_at_eol (&cmdLine))  stepcnt = 1;
+      else if ( tm_get_num (&cmdLine))  stepcnt = abs(cmdLine.num);
       else   printf("Step count?\n");
       break;
 
@@ -467,7 +529,7 @@ int doCommand (void)
     case 'r' :
     /***********************************/
       for (i = 0; i < NO_REGS; i++)
-      { printf("%1d: %4d    ", i,reg[i]);
+      { printf("%1d: %4d    ", i,tm->reg[i]);
         if ( (i % 4) == 3 ) printf ("\n");
       }
       break;
@@ -475,16 +537,16 @@ int doCommand (void)
     case 'i' :
     /***********************************/
       printcnt = 1 ;
-      if ( getNum ())
-      { iloc = num ;
-        if ( getNum ()) printcnt = num ;
+      if ( tm_get_num (&cmdLine))
+      { iloc = cmdLine.num ;
+        if ( tm_get_num (&cmdLine)) printcnt = cmdLine.num ;
       }
-      if ( ! atEOL ())
+      if ( ! tm_at_eol (&cmdLine))
         printf ("Instruction locations?\n");
       else
-      { while ((iloc >= 0) && (iloc < IADDR_SIZE)
+      { while ((iloc >= 0) && (iloc < tm->pgm->iMemSize)
                 && (printcnt > 0) )
-        { writeInstruction(iloc);
+        { tm_write_instruction(tm,stdout,iloc);
           iloc++ ;
           printcnt-- ;
         }
@@ -494,16 +556,16 @@ int doCommand (void)
     case 'd' :
     /***********************************/
       printcnt = 1 ;
-      if ( getNum  ())
-      { dloc = num ;
-        if ( getNum ()) printcnt = num ;
+      if ( tm_get_num (&cmdLine))
+      { dloc = cmdLine.num ;
+        if ( tm_get_num (&cmdLine)) printcnt = cmdLine.num ;
       }
-      if ( ! atEOL ())
+      if ( ! tm_at_eol (&cmdLine))
         printf("Data locations?\n");
       else
-      { while ((dloc >= 0) && (dloc < DADDR_SIZE)
+      { while ((dloc >= 0) && (dloc < tm->dSize)
                   && (printcnt > 0))
-        { printf("%5d: %5d\n",dloc,dMem[dloc]);
+        { printf("%5d: %5d\n",dloc,tm->dMem[dloc]);
           dloc++;
           printcnt--;
         }
@@ -515,11 +577,11 @@ int doCommand (void)
       iloc = 0;
       dloc = 0;
       stepcnt = 0;
-      for (regNo = 0;  regNo < NO_REGS ; regNo++)
-            reg[regNo] = 0 ;
-      dMem[0] = DADDR_SIZE - 1 ;
-      for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-            dMem[loc] = 0 ;
+      tm_reset(tm);
+      if ( revflag && ! tm_rev_start (tm) )
+      { printf("Out of memory for the history.\n");
+        revflag = FALSE;
+      }
       break;
 
     case 'q' : return FALSE;  /* break; */
@@ -530,24 +592,38 @@ int doCommand (void)
   if ( stepcnt > 0 )
   { if ( cmd == 'g' )
     { stepcnt = 0;
-      while (stepResult == srOKAY)
-      { iloc = reg[PC_REG] ;
-        if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
-        stepcnt++;
-      }
+      startTime = clock();
+      used = (traceflag || (tm->rev != NULL)) ? engSWITCH : tm->engine;
+      if ( (used == engJIT) && (tm->watch != NULL) ) used = engTHREADED;
+      stepResult = goTM (&stepcnt);
       if ( icountflag )
+      { seconds = (double) (clock() - startTime) / CLOCKS_PER_SEC;
         printf("Number of instructions executed = %d\n",stepcnt);
+        printf("Execution time (%s) = %.3f sec",
+               engineTab[used],seconds);
+        if ( seconds > 0 )
+          printf(", %.0f instructions/sec",stepcnt / seconds);
+        printf("\n");
+        if ( used == engTHREADED )
+          printf("Dispatches saved by superinstructions = %d (%.1f%%)\n",
+                 tm->fused,stepcnt ? 100.0 * tm->fused / stepcnt : 0.0);
+      }
     }
     else
     { while ((stepcnt > 0) && (stepResult == srOKAY))
-      { iloc = reg[PC_REG] ;
-        if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
+      { iloc = tm->reg[PC_REG] ;
+        if ( traceflag ) tm_write_instruction( tm, stdout, iloc ) ;
+        stepResult = tm_step (tm);
         stepcnt-- ;
       }
     }
+    if ( stepResult == srHALT ) writeHalt ();
+    if ( stepResult == srWATCH )
+      printf("dMem[%d] was %d, now %d\n",tm->watch->addr,
+             tm->watch->old,tm->dMem[tm->watch->addr]);
     printf( "%s\n",stepResultTab[stepResult] );
+    if ( (stepResult == srBREAK) || (stepResult == srLIMIT) )
+      tm_write_instruction(tm,stdout,tm->reg[PC_REG]);
   }
   return TRUE;
 } /* doCommand */
@@ -558,29 +634,197 @@ int doCommand (void)
 /********************************************/
 
 main( int argc, char * argv[] )
-{ if (argc != 2)
-  { printf("usage: %s <filename>\n",argv[0]);
+{ char * outName = NULL;
+  char * inName = NULL;
+  char * batchName = NULL;
+  char * setsName = NULL;
+  int engine = -1, check = FALSE;
+  int maxSteps = 0;
+  double maxSeconds = 0;
+  int iLimit = IADDR_SIZE, dSize = DADDR_SIZE;
+  FILE * out;
+  int i, ok, stepcnt;
+  STEPRESULT stepResult;
+  for (i = 1; (i < argc - 1) && (argv[i][0] == '-'); i++)
+  { if ( (strcmp(argv[i],"-x") == 0) && (i < argc - 2) )
+      outName = argv[++i];
+    else if (strcmp(argv[i],"-b") == 0)
+      batchflag = TRUE;
+    else if ( (strcmp(argv[i],"-i") == 0) && (i < argc - 2) )
+      inName = argv[++i];
+    else if ( (strcmp(argv[i],"-o") == 0) && (i < argc - 2) )
+      batchName = argv[++i];
+    else if ( (strcmp(argv[i],"-f") == 0) && (i < argc - 2)
+              && ( (strcmp(argv[i+1],"int") == 0)
+                   || (strcmp(argv[i+1],"bin") == 0) ) )
+      binaryflag = (strcmp(argv[++i],"bin") == 0);
+    else if ( (strcmp(argv[i],"-m") == 0) && (i < argc - 2) )
+      setsName = argv[++i];
+    else if (strcmp(argv[i],"-k") == 0)
+      forkflag = TRUE;
+    else if ( (strcmp(argv[i],"-j") == 0) && (i < argc - 2)
+              && (atoi(argv[i+1]) > 0) )
+      nthreads = atoi(argv[++i]);
+    else if ( (strcmp(argv[i],"-e") == 0) && (i < argc - 2) )
+    { for (engine = engJIT; engine >= 0; engine--)
+        if (strcmp(argv[i+1],engineTab[engine]) == 0) break;
+      if ( (engine < 0) || ((engine == engTHREADED) && ! HAVE_THREADED)
+           || ((engine == engJIT) && ! HAVE_JIT) )
+        break;
+      i++;
+    }
+    else if (strcmp(argv[i],"-v") == 0)
+      check = TRUE;
+    else if ( (strcmp(argv[i],"-I") == 0) && (i < argc - 2)
+              && (atoi(argv[i+1]) > 0) )
+      iLimit = atoi(argv[++i]);
+    else if ( (strcmp(argv[i],"-D") == 0) && (i < argc - 2)
+              && (atoi(argv[i+1]) > 0) )
+      dSize = atoi(argv[++i]);
+    else if ( (strcmp(argv[i],"-l") == 0) && (i < argc - 2)
+              && (atoi(argv[i+1]) > 0) )
+      maxSteps = atoi(argv[++i]);
+    else if ( (strcmp(argv[i],"-T") == 0) && (i < argc - 2)
+              && (atof(argv[i+1]) > 0) )
+      maxSeconds = atof(argv[++i]);
+    else if ( (strcmp(argv[i],"-p") == 0) && (i < argc - 2) )
+      profName = argv[++i];
+    else if ( (strcmp(argv[i],"-t") == 0) && (i < argc - 2) )
+      traceName = argv[++i];
+    else break;
+  }
+  if (i != argc - 1)
+  { printf("usage: %s [-x <outfile>] "\
+           "[-b [-i <infile>] [-o <outfile>] [-f int|bin]]\n"\
+           "       [-m <setsfile> [-j <threads>] [-k] [-o <outfile>]]\n"\
+           "       [-e switch|threaded|jit] [-v] [-I <size>] [-D <size>]\n"\
+           "       [-l <count>] [-T <seconds>]\n"\
+           "       [-p <proffile>] [-t <tracefile>] <filename>\n",
+           argv[0]);
+    printf("   -x <outfile>   convert the program instead of running it;\n"\
+           "                  <outfile> is binary if it ends in .tmb, and\n"\
+           "                  a C program acting like -b if it ends in .c\n");
+    printf("   -b             run once without the command prompt and\n"\
+           "                  exit with the final step result as status\n");
+    printf("   -i <infile>    batch IN values (default: standard input)\n");
+    printf("   -o <outfile>   batch OUT values (default: standard output)\n");
+    printf("   -f int|bin     batch OUT format: decimal lines or\n"\
+           "                  packed binary ints\n");
+    printf("   -m <setsfile>  run once for each line of input values\n"\
+           "                  in <setsfile>, writing a line of OUT\n"\
+           "                  values per run, in the same order\n");
+    printf("   -j <threads>   threads for -m (default: one per processor)\n");
+    printf("   -k             fork server for -m: run up to the first IN\n"\
+           "                  once, then finish each run in a forked\n"\
+           "                  process (<threads> at a time)\n");
+    printf("   -e <engine>    engine for running the program\n");
+    printf("   -v             check JIT code against the interpreter\n");
+    printf("   -I <size>      iMem locations (default %d, or as many\n"\
+           "                  as the program needs)\n",IADDR_SIZE);
+    printf("   -D <size>      dMem locations (default %d); memory is\n"\
+           "                  only used for the pages touched\n",DADDR_SIZE);
+    printf("   -l <count>     stop each run (each 'go') after about\n"\
+           "                  <count> instructions: the end of the basic\n"\
+           "                  block it is in\n");
+    printf("   -T <seconds>   stop each run after <seconds> of\n"\
+           "                  wall-clock time\n");
+    printf("   -p <proffile>  count executions and taken jumps of each\n"\
+           "                  location (not with -m): a report by source\n"\
+           "                  line goes to the terminal (stderr with -b)\n"\
+           "                  and the counts to <proffile>\n");
+    printf("   -t <tracefile> write a binary record of each instruction\n"\
+           "                  executed (not with -m); tmdecode shows it\n");
     exit(1);
   }
-  strcpy(pgmName,argv[1]) ;
+  strcpy(pgmName,argv[i]) ;
   if (strchr (pgmName, '.') == NULL)
      strcat(pgmName,".tm");
-  pgm = fopen(pgmName,"r");
-  if (pgm == NULL)
-  { printf("file '%s' not found\n",pgmName);
+  tm = tm_create();
+  if (tm == NULL)
+  { printf("out of memory\n");
+    exit(1);
+  }
+
+  if (engine >= 0) tm->engine = engine;
+  tm->jitCheck = check;
+  tm->maxSteps = maxSteps;
+  tm->maxSeconds = maxSeconds;
+  if (! tm_set_memory (tm,iLimit,dSize))
+  { printf("cannot set up %d iMem and %d dMem locations\n",iLimit,dSize);
     exit(1);
   }
 
   /* read the program */
-  if ( ! readInstructions ())
+  if ( ! tm_load (tm,pgmName))
          exit(1) ;
+  if ( (profName != NULL) && (outName == NULL) && (setsName == NULL)
+       && ! tm_profile_start (tm) )
+  { printf("out of memory for the profile\n");
+    exit(1);
+  }
+  if ( (traceName != NULL) && (outName == NULL) && (setsName == NULL) )
+  { traceFile = fopen(traceName,"wb");
+    if ( (traceFile == NULL) || ! tm_trace_start (tm,traceFile) )
+    { printf("cannot create '%s'\n",traceName);
+      exit(1);
+    }
+  }
+  if (outName != NULL)
+  { out = fopen(outName,tm_is_object(outName) ? "wb" : "w");
+    if (out == NULL)
+    { printf("cannot create '%s'\n",outName);
+      exit(1);
+    }
+    if (tm_is_object(outName)) ok = tm_write_object(tm,out);
+    else if (isCSource(outName)) ok = tm_write_c(tm,out,pgmName);
+    else ok = tm_write_text(tm,out);
+    if (fclose(out) != 0) ok = FALSE;
+    if (! ok)
+    { printf("error writing '%s'\n",outName);
+      exit(1);
+    }
+    return 0;
+  }
+  if (setsName != NULL)
+    return runSets (setsName,batchName);
+  if (batchflag)
+  { if (! readValues (inName))
+      exit(1);
+    tm->output = putValue;
+    outFile = stdout;
+    if ( (batchName != NULL)
+         && ((outFile = fopen(batchName,binaryflag ? "wb" : "w")) == NULL) )
+    { fprintf(stderr,"cannot create '%s'\n",batchName);
+      exit(1);
+    }
+    stepResult = goTM (&stepcnt);
+    flushValues ();
+    if (fclose(outFile) != 0)
+    { fprintf(stderr,"error writing batch output\n");
+      exit(1);
+    }
+    if (stepResult != srHALT)
+      fprintf(stderr,"%s at location %d after %d instructions\n",
+              stepResultTab[stepResult],tm->iloc,stepcnt);
+    if ( (profName != NULL) && ! writeProfile (stderr) )
+      exit(1);
+    if (! endTrace ())
+      exit(1);
+    return stepResult;
+  }
   /* switch input file to terminal */
   /* reset( input ); */
   /* read-eval-print */
+  tm->input = askValue;
+  tm->output = printValue;
   printf("TM  simulation (enter h for help)...\n");
   do
      done = ! doCommand ();
   while (! done );
+  if ( (profName != NULL) && ! writeProfile (stdout) )
+    exit(1);
+  if (! endTrace ())
+    exit(1);
   printf("Simulation done.\n");
   return 0;
 }
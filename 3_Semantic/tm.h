@@ -0,0 +1,103 @@
+/****************************************************/
+/* File: tm.h                                       */
+/* TM instruction set and binary object format,     */
+/* shared by the TM simulator and the code emitter  */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TM_H_
+#define _TM_H_
+
+typedef enum {
+   /* RR instructions */
+   opHALT,    /* RR     halt, operands are ignored */
+   opIN,      /* RR     read into reg(r); s and t are ignored */
+   opOUT,     /* RR     write from reg(r), s and t are ignored */
+   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
+   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
+   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
+   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
+   opPUSH,   /* RR     mem(reg(s)) = reg(r); reg(s)-- ; t is ignored */
+   opPOP,    /* RR     reg(s)++; reg(r) = mem(reg(s)) ; t is ignored */
+   opRET,    /* RR     reg(s)++; reg(7) = mem(reg(s)) ; r, t ignored */
+   opMCPY,   /* RR     reg(t) words of mem from reg(s) on copied to reg(r) on */
+   opMSET,   /* RR     reg(t) words of mem from reg(r) on set to reg(s) */
+   opVADD,   /* RR     mem(reg(r)+k) += mem(reg(s)+k) for k < reg(t) */
+   opVMUL,   /* RR     mem(reg(r)+k) *= mem(reg(s)+k) for k < reg(t) */
+   opVSUM,   /* RR     reg(r) = sum of the reg(t) words of mem from reg(s) */
+   opVMIN,   /* RR     reg(r) = k of the last new least of reg(r), mem(reg(s)+k), k < reg(t) */
+   opVMAX,   /* RR     reg(r) = k of the last new greatest of reg(r), mem(reg(s)+k), k < reg(t) */
+   opRRLim,   /* limit of RR opcodes */
+
+   /* RM instructions */
+   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
+   opST,      /* RM     mem(d+reg(s)) = reg(r) */
+   opRMLim,   /* Limit of RM opcodes */
+
+   /* RA instructions */
+   opLDA,     /* RA     reg(r) = d+reg(s) */
+   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
+   opCALL,    /* RA     mem(reg(r)) = reg(7); reg(r)--; reg(7) = d+reg(s) */
+   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
+   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
+   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
+   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
+   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
+   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+   opRALim    /* Limit of RA opcodes */
+   } OPCODE;
+
+/* PUSH, POP, RET and CALL keep a stack that grows
+ * down in mem, the stack pointer (reg(s), reg(r)
+ * for CALL) giving the first free word; the pc
+ * cannot be the stack pointer. MCPY, MSET and
+ * the vector instructions VADD..VMAX fault
+ * unless all the words are in mem; the words
+ * read are all read before any is written, so
+ * the blocks may overlap. VMIN (VMAX) goes
+ * through the words keeping a least (greatest)
+ * x, from reg(r) on: a word w is the new x when
+ * w - x, wrapped around, is below (above) 0, as
+ * SUB then JLT (JGT) tests. It gives the k of
+ * the last new x, or -1 if there is none.
+ */
+
+/* opcode mnemonics indexed by OPCODE,
+ * with "????" at the class limits
+ */
+#define TM_OPCODE_NAMES \
+        {"HALT","IN","OUT","ADD","SUB","MUL","DIV","PUSH","POP","RET", \
+         "MCPY","MSET","VADD","VMUL","VSUM","VMIN","VMAX","????", \
+         "LD","ST","????", \
+         "LDA","LDC","CALL","JLT","JLE","JGT","JGE","JEQ","JNE","????" \
+        }
+
+/* A binary TM object (.tmb) file is a TMBHEADER
+ * followed by one TMBINSTR for each iMem location
+ * from 0 to size-1, in host byte order. Locations
+ * never emitted read as zero, i.e. HALT 0,0,0.
+ * Every instruction is stored as (op,r,s,t,d):
+ * RR instructions leave d at 0 and RM/RA ones
+ * leave t at 0, s being the base register.
+ */
+#define TMB_MAGIC  0x34424D54   /* "TMB4" read as an int */
+
+typedef struct {
+      int magic ;
+      int size ;
+   } TMBHEADER;
+
+typedef struct {
+      int code ;   /* op, r, s and t packed by TMB_CODE */
+      int disp ;   /* d */
+   } TMBINSTR;
+
+#define TMB_CODE(op,r,s,t) \
+        ((op) | ((r) << 8) | ((s) << 12) | ((t) << 16))
+#define TMB_OP(c)  ((c) & 0xff)
+#define TMB_R(c)   (((c) >> 8) & 0xf)
+#define TMB_S(c)   (((c) >> 12) & 0xf)
+#define TMB_T(c)   (((c) >> 16) & 0xf)
+
+#endif
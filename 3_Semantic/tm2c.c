@@ -0,0 +1,295 @@
+/****************************************************/
+/* File: tm2c.c                                     */
+/* Translation of a TM program to a C program that  */
+/* behaves like "tm -b" running it                  */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "tmvm.h"
+
+/* The translation keeps registers 0-6 in locals
+ * r0..r6; register 7 is known at each location,
+ * so reading it gives a constant and writing it
+ * is a jump. Every location k gets a label B_k,
+ * and the first location of each basic block a
+ * label L_k that adds the length of the block to
+ * the instruction count. Jumps to a location
+ * known in advance are gotos; the others set pc
+ * and go through the switch at "dispatch".
+ * Faults take back the part of the count not
+ * executed, so counts match tm_step exactly.
+ */
+
+/* the value of register r at location loc */
+static void regName (char * buf, int r, int loc)
+{ if (r == PC_REG) sprintf(buf,"%d",loc + 1);
+  else sprintf(buf,"r%d",r);
+} /* regName */
+
+/* a fault or HALT at loc, in a block with left
+ * instructions from loc on: stop with res
+ */
+static void writeStop (FILE * out, int loc, int left, int res)
+{ fprintf(out,"{ count -= %d; iloc = %d; result = %d; goto done; }",
+          left - 1,loc,res);
+} /* writeStop */
+
+/* the target of a jump in iMem[loc], or -1 if
+ * it is not known before the program runs
+ */
+static int jumpTarget (INSTRUCTION * in, int loc)
+{ if (in->iop == opLDC) return in->iarg2;
+  if ( (in->iop == opLDA) || (in->iop == opCALL)
+       || ((in->iop >= opJLT) && (in->iop <= opJNE)) )
+    if (in->iarg3 == PC_REG) return loc + 1 + in->iarg2;
+  return -1;
+} /* jumpTarget */
+
+/* does iMem[loc] write the pc? */
+static int isJump (INSTRUCTION * in)
+{ if ( (in->iop >= opJLT) && (in->iop <= opJNE) ) return TRUE;
+  if ( (in->iop == opCALL) || (in->iop == opRET) ) return TRUE;
+  return (in->iarg1 == PC_REG) && (in->iop != opST) && (in->iop != opPUSH)
+         && (in->iop != opMCPY) && (in->iop != opMSET)
+         && (in->iop != opVADD) && (in->iop != opVMUL)
+         && (in->iop != opOUT) && (in->iop != opHALT);
+} /* isJump */
+
+/********************************************/
+/* tm_write_c writes a C program running the
+ * program of tm with the input, output, exit
+ * status and fault messages of "tm -b"
+ */
+int tm_write_c (TMState * tm, FILE * out, char * name)
+{ static const char * jumpTest[] =
+    { "< 0", "<= 0", "> 0", ">= 0", "== 0", "!= 0" };
+  TMProgram * pgm = tm->pgm;
+  INSTRUCTION * in;
+  char * leader;
+  int * left;
+  char rs[16], rt[16], rr[16], dest[16];
+  int size = pgm->iSize, loc, end, k, target, vector = FALSE;
+  leader = (char *) calloc(size + 1,1);
+  left = (int *) malloc((size + 1) * sizeof(int)); /* rest of the block */
+  if ( (leader == NULL) || (left == NULL) )
+  { free(leader);
+    free(left);
+    return FALSE;
+  }
+  leader[0] = TRUE;
+  for (loc = 0; loc < size; loc++)
+  { in = &pgm->iMem[loc];
+    if ( isJump(in) || (in->iop == opHALT) ) leader[loc+1] = TRUE;
+    if ( (in->iop >= opVADD) && (in->iop <= opVMAX) ) vector = TRUE;
+    if ( isJump(in) && ((target = jumpTarget(in,loc)) >= 0)
+         && (target < size) )
+      leader[target] = TRUE;
+  }
+  for (loc = size - 1, end = size; loc >= 0; loc--)
+  { left[loc] = end - loc;
+    if (leader[loc]) end = loc;
+  }
+
+  fprintf(out,"/* TM program %s translated to C by tm -x */\n",name);
+  fprintf(out,"/* compile with: gcc -O2 -fwrapv */\n\n");
+  fprintf(out,"#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n\n");
+  fprintf(out,"#define IADDR_SIZE %d\n#define DADDR_SIZE %d\n\n",
+          pgm->iMemSize,tm->dSize);
+  fprintf(out,"static int dMem[DADDR_SIZE];\n");
+  fprintf(out,"static int inCount = 0;\n\n");
+  fprintf(out,"/* IN: the next whitespace separated integer */\n");
+  fprintf(out,"static int readValue (int * v)\n");
+  fprintf(out,"{ int n = scanf(\"%%d\",v);\n");
+  fprintf(out,"  if (n == 1) { inCount++; return 1; }\n");
+  fprintf(out,"  if (n == EOF) return 0;\n");
+  fprintf(out,"  fprintf(stderr,\"illegal input value after %%d values\\n\","\
+              "inCount);\n");
+  fprintf(out,"  exit(1);\n}\n\n");
+  if (vector)
+  { fprintf(out,"/* VADD, VMUL: b is read before a is written */\n");
+    fprintf(out,"static void vecOp (int mul, int * a, int * b, int n)\n");
+    fprintf(out,"{ int k;\n");
+    fprintf(out,"  if ((a <= b) || (a >= b + n))\n");
+    fprintf(out,"    for (k = 0; k < n; k++) "\
+                "a[k] = mul ? a[k] * b[k] : a[k] + b[k];\n");
+    fprintf(out,"  else\n");
+    fprintf(out,"    for (k = n - 1; k >= 0; k--) "\
+                "a[k] = mul ? a[k] * b[k] : a[k] + b[k];\n}\n\n");
+    fprintf(out,"static int vecSum (int * a, int n)\n");
+    fprintf(out,"{ int k, sum = 0;\n");
+    fprintf(out,"  for (k = 0; k < n; k++) sum += a[k];\n");
+    fprintf(out,"  return sum;\n}\n\n");
+    fprintf(out,"/* VMIN, VMAX: the last new least or greatest from x "\
+                "on, by the wrapped difference */\n");
+    fprintf(out,"static int vecBest (int * a, int n, int x, int max)\n");
+    fprintf(out,"{ int k, best = -1;\n");
+    fprintf(out,"  for (k = 0; k < n; k++)\n");
+    fprintf(out,"    if (max ? a[k] - x > 0 : a[k] - x < 0) "\
+                "{ x = a[k]; best = k; }\n");
+    fprintf(out,"  return best;\n}\n\n");
+  }
+  fprintf(out,"int main (void)\n");
+  fprintf(out,"{ static const char * stepResultTab[] =\n    {");
+  for (k = srOKAY; k <= srNO_INPUT; k++)
+    fprintf(out,"%s\"%s\"",k ? "," : " ",stepResultTab[k]);
+  fprintf(out," };\n");
+  fprintf(out,"  int r0 = 0, r1 = 0, r2 = 0, r3 = 0, r4 = 0, r5 = 0, "\
+              "r6 = 0;\n");
+  fprintf(out,"  int pc, m, count = 0, iloc, result;\n");
+  fprintf(out,"  dMem[0] = DADDR_SIZE - 1;\n");
+
+  for (loc = 0; loc < size; loc++)
+  { in = &pgm->iMem[loc];
+    if (leader[loc])
+      fprintf(out,"L_%d: count += %d;\n",loc,left[loc]);
+    regName(rr,in->iarg1,loc);
+    if (opClass(in->iop) == opclRR)
+    { regName(rs,in->iarg2,loc);
+      regName(rt,in->iarg3,loc);
+    }
+    else regName(rs,in->iarg3,loc);
+    /* where a result goes: pc means a jump */
+    if (in->iarg1 == PC_REG) strcpy(dest,"pc");
+    else strcpy(dest,rr);
+    fprintf(out,"B_%d: ",loc);
+    switch (in->iop)
+    { case opHALT :
+        writeStop(out,loc,left[loc],srHALT);
+        break;
+      case opIN :
+        fprintf(out,"if (! readValue(&%s)) ",
+                in->iarg1 == PC_REG ? "pc" : rr);
+        writeStop(out,loc,left[loc],srNO_INPUT);
+        break;
+      case opOUT :
+        fprintf(out,"printf(\"%%d\\n\",%s);",rr);
+        break;
+      case opADD :
+      case opSUB :
+      case opMUL :
+        fprintf(out,"%s = %s %c %s;",dest,rs,
+                in->iop == opADD ? '+' : in->iop == opSUB ? '-' : '*',rt);
+        break;
+      case opDIV :
+        fprintf(out,"if (%s == 0) ",rt);
+        writeStop(out,loc,left[loc],srZERODIVIDE);
+        /* the least int over -1 wraps around */
+        fprintf(out,"\n      %s = %s == -1 ? (int) (0u - (unsigned) %s) : %s / %s;",
+                dest,rt,rs,rs,rt);
+        break;
+      case opLD :
+      case opST :
+        fprintf(out,"m = %d + %s; if ((unsigned) m >= DADDR_SIZE) ",
+                in->iarg2,rs);
+        writeStop(out,loc,left[loc],srDMEM_ERR);
+        if (in->iop == opLD) fprintf(out,"\n      %s = dMem[m];",dest);
+        else fprintf(out,"\n      dMem[m] = %s;",rr);
+        break;
+      case opPUSH :
+        fprintf(out,"m = %s; if ((unsigned) m >= DADDR_SIZE) ",rs);
+        writeStop(out,loc,left[loc],srDMEM_ERR);
+        fprintf(out,"\n      dMem[m] = %s; %s = m - 1;",rr,rs);
+        break;
+      case opPOP :
+      case opRET :
+        fprintf(out,"m = %s + 1; if ((unsigned) m >= DADDR_SIZE) ",rs);
+        writeStop(out,loc,left[loc],srDMEM_ERR);
+        fprintf(out,"\n      %s = m; %s = dMem[m];",rs,
+                in->iop == opRET ? "pc" : dest);
+        break;
+      case opCALL :
+        /* the target is from before the push */
+        if (jumpTarget(in,loc) < 0)
+          fprintf(out,"pc = %d + %s; ",in->iarg2,rs);
+        fprintf(out,"m = %s; if ((unsigned) m >= DADDR_SIZE) ",rr);
+        writeStop(out,loc,left[loc],srDMEM_ERR);
+        fprintf(out,"\n      dMem[m] = %d; %s = m - 1;",loc + 1,rr);
+        break;
+      case opMCPY :
+      case opMSET :
+        fprintf(out,"if ((%s < 0) || (%s < 0) || (%s > DADDR_SIZE - %s)",
+                rt,rr,rr,rt);
+        if (in->iop == opMCPY)
+          fprintf(out," || (%s < 0) || (%s > DADDR_SIZE - %s)",rs,rs,rt);
+        fprintf(out,") ");
+        writeStop(out,loc,left[loc],srDMEM_ERR);
+        if (in->iop == opMCPY)
+          fprintf(out,"\n      memmove(dMem + %s,dMem + %s,%s * sizeof(int));",
+                  rr,rs,rt);
+        else
+          fprintf(out,"\n      for (m = 0; m < %s; m++) dMem[%s + m] = %s;",
+                  rt,rr,rs);
+        break;
+      case opVADD :
+      case opVMUL :
+        fprintf(out,"if ((%s < 0) || (%s < 0) || (%s > DADDR_SIZE - %s)"\
+                    " || (%s < 0) || (%s > DADDR_SIZE - %s)) ",
+                rt,rr,rr,rt,rs,rs,rt);
+        writeStop(out,loc,left[loc],srDMEM_ERR);
+        fprintf(out,"\n      vecOp(%d,dMem + %s,dMem + %s,%s);",
+                in->iop == opVMUL,rr,rs,rt);
+        break;
+      case opVSUM :
+      case opVMIN :
+      case opVMAX :
+        fprintf(out,"if ((%s < 0) || (%s < 0) || (%s > DADDR_SIZE - %s)) ",
+                rt,rs,rs,rt);
+        writeStop(out,loc,left[loc],srDMEM_ERR);
+        if (in->iop == opVSUM)
+          fprintf(out,"\n      %s = vecSum(dMem + %s,%s);",dest,rs,rt);
+        else
+          fprintf(out,"\n      %s = vecBest(dMem + %s,%s,%s,%d);",dest,rs,rt,
+                  rr,in->iop == opVMAX);
+        break;
+      case opLDA :
+        fprintf(out,"%s = %d + %s;",dest,in->iarg2,rs);
+        break;
+      case opLDC :
+        fprintf(out,"%s = %d;",dest,in->iarg2);
+        break;
+      default :
+        fprintf(out,"if (%s %s) ",rr,jumpTest[in->iop - opJLT]);
+        strcpy(dest,"pc");
+        break;
+    }
+    if (isJump(in))
+    { target = jumpTarget(in,loc);
+      if ( (target >= 0) && (target < size) )
+        fprintf(out," goto L_%d;",target);
+      else if (target >= 0)
+        fprintf(out," { pc = %d; goto dispatch; }",target);
+      else if ( (in->iop >= opJLT) && (in->iop <= opJNE) )
+        fprintf(out," { pc = %d + %s; goto dispatch; }",in->iarg2,rs);
+      else fprintf(out," goto dispatch;");
+    }
+    fprintf(out,"\n");
+  }
+  /* falling off the end, or jumping past it */
+  fprintf(out,"  pc = %d;\n",size);
+  fprintf(out,"dispatch:\n  switch (pc)\n  {");
+  for (loc = 0; loc < size; loc++)
+    fprintf(out,"%s case %d: count += %d; goto B_%d;\n",
+            loc ? "   " : "",loc,left[loc],loc);
+  fprintf(out,"    default:\n");
+  fprintf(out,"      count++;\n");
+  fprintf(out,"      iloc = pc;\n");
+  fprintf(out,"      /* iMem past the program holds HALT */\n");
+  fprintf(out,"      result = ((pc >= 0) && (pc < IADDR_SIZE)) ? %d : %d;\n",
+          srHALT,srIMEM_ERR);
+  fprintf(out,"  }\n");
+  fprintf(out,"done:\n");
+  fprintf(out,"  if (fflush(stdout) != 0)\n");
+  fprintf(out,"  { fprintf(stderr,\"error writing batch output\\n\");\n");
+  fprintf(out,"    return 1;\n  }\n");
+  fprintf(out,"  if (result != %d)\n",srHALT);
+  fprintf(out,"    fprintf(stderr,\"%%s at location %%d after %%d "\
+              "instructions\\n\",\n");
+  fprintf(out,"            stepResultTab[result],iloc,count);\n");
+  fprintf(out,"  return result;\n}\n");
+  free(leader);
+  free(left);
+  return ! ferror(out);
+} /* tm_write_c */
@@ -0,0 +1,112 @@
+/****************************************************/
+/* File: tmbench.c                                  */
+/* Compares running a TM program many times inside  */
+/* one process through the TM library with running  */
+/* it once per spawned "tm -b" process              */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "tmvm.h"
+
+/********************************************/
+static double now (void)
+{ struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+} /* now */
+
+/********************************************/
+static int readInput (char * name, int ** vals)
+{ FILE * in;
+  int cnt = 0, cap = 16, v;
+  *vals = (int *) malloc(cap * sizeof(int));
+  if (name == NULL) return 0;
+  in = fopen(name,"r");
+  if (in == NULL)
+  { fprintf(stderr,"input file '%s' not found\n",name);
+    exit(1);
+  }
+  while (fscanf(in,"%d",&v) == 1)
+  { if (cnt == cap) *vals = (int *) realloc(*vals,(cap *= 2) * sizeof(int));
+    (*vals)[cnt++] = v;
+  }
+  fclose(in);
+  return cnt;
+} /* readInput */
+
+/********************************************/
+/* spawnRun runs "tm -b pgm" with stdin from
+ * inName and stdout discarded
+ */
+static int spawnRun (char * tmPath, char * pgm, char * inName)
+{ int status, fd;
+  pid_t pid = fork();
+  if (pid == 0)
+  { fd = open(inName ? inName : "/dev/null",O_RDONLY);
+    dup2(fd,0);
+    fd = open("/dev/null",O_WRONLY);
+    dup2(fd,1);
+    execl(tmPath,tmPath,"-b",pgm,(char *) NULL);
+    _exit(127);
+  }
+  if ( (pid < 0) || (waitpid(pid,&status,0) < 0) ) return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+} /* spawnRun */
+
+/********************************************/
+int main (int argc, char * argv[])
+{ char * inName = NULL;
+  char * tmPath = "./tm";
+  int runs = 1000;
+  TMState * tm;
+  STEPRESULT result;
+  double start, embedded, spawned;
+  int * vals, nvals, icount, i;
+  for (i = 1; (i < argc - 1) && (argv[i][0] == '-'); i++)
+  { if ( (strcmp(argv[i],"-n") == 0) && (i < argc - 2) )
+      runs = atoi(argv[++i]);
+    else if ( (strcmp(argv[i],"-i") == 0) && (i < argc - 2) )
+      inName = argv[++i];
+    else if ( (strcmp(argv[i],"-t") == 0) && (i < argc - 2) )
+      tmPath = argv[++i];
+    else break;
+  }
+  if ( (i != argc - 1) || (runs <= 0) )
+  { fprintf(stderr,"usage: %s [-n runs] [-i infile] [-t tm] <program>\n",
+            argv[0]);
+    exit(1);
+  }
+  nvals = readInput(inName,&vals);
+  tm = tm_create();
+  if ( (tm == NULL) || ! tm_load(tm,argv[i]) )
+    exit(1);
+
+  start = now();
+  for (i = 0; i < runs; i++)
+  { tm_reset(tm);
+    tm_set_input(tm,vals,nvals);
+    result = tm_run(tm,&icount);
+  }
+  embedded = (now() - start) / runs;
+  printf("embedded: %d runs, %d instructions each, %s\n",
+         runs,icount,stepResultTab[result]);
+
+  start = now();
+  for (i = 0; i < runs; i++)
+    if (spawnRun(tmPath,argv[argc-1],inName) != srHALT)
+    { fprintf(stderr,"%s -b %s did not halt\n",tmPath,argv[argc-1]);
+      exit(1);
+    }
+  spawned = (now() - start) / runs;
+
+  printf("per run:  embedded %.2f us, spawned %.2f us (%.0fx)\n",
+         embedded * 1e6,spawned * 1e6,spawned / embedded);
+  tm_destroy(tm);
+  return 0;
+}
@@ -0,0 +1,107 @@
+/****************************************************/
+/* File: tmbreak.c                                  */
+/* Breakpoints and watchpoints for the TM library   */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "tmbreak.h"
+#include "tmjit.h"
+
+/********************************************/
+int tm_break_set (TMState * tm, int loc, int on)
+{ TMProgram * pgm = tm->pgm;
+  TMBreak * brk = pgm->brk;
+  on = (on != 0);
+  if ( (loc < 0) || (loc >= pgm->iMemSize) ) return FALSE;
+  if (brk == NULL)
+  { if (! on) return TRUE;
+    brk = (TMBreak *) malloc(sizeof(TMBreak));
+    if (brk == NULL) return FALSE;
+    brk->at = (char *) calloc(pgm->iMemSize,1);
+    if (brk->at == NULL)
+    { free(brk);
+      return FALSE;
+    }
+    brk->count = 0;
+    pgm->brk = brk;
+  }
+  if (brk->at[loc] == on) return TRUE;
+  brk->at[loc] = on;
+  brk->count += on ? 1 : -1;
+  if (brk->count == 0)
+  { tm_break_free(brk);
+    pgm->brk = NULL;
+  }
+  /* compiled code runs through the old ones */
+  tm_jit_free(tm);
+  tm_decode(tm);
+  return TRUE;
+} /* tm_break_set */
+
+/********************************************/
+int tm_break_at (TMState * tm, int loc)
+{ TMBreak * brk = tm->pgm->brk;
+  return (brk != NULL) && (loc >= 0) && (loc < tm->pgm->iMemSize)
+         && brk->at[loc];
+} /* tm_break_at */
+
+/********************************************/
+void tm_break_free (TMBreak * brk)
+{ if (brk == NULL) return;
+  free(brk->at);
+  free(brk);
+} /* tm_break_free */
+
+/********************************************/
+int tm_watch_set (TMState * tm, int addr, int on)
+{ TMWatch * watch = tm->watch;
+  int bit;
+  on = (on != 0);
+  if ( (addr < 0) || (addr >= tm->dSize) ) return FALSE;
+  if (watch == NULL)
+  { if (! on) return TRUE;
+    watch = (TMWatch *) malloc(sizeof(TMWatch));
+    if (watch == NULL) return FALSE;
+    watch->size = tm->dSize / 8 + 1;
+    watch->bits = (unsigned char *) mmap(NULL,watch->size,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,-1,0);
+    if (watch->bits == MAP_FAILED)
+    { free(watch);
+      return FALSE;
+    }
+    watch->tMem = NULL;
+    watch->count = 0;
+    watch->addr = -1;
+    watch->old = 0;
+    tm->watch = watch;
+    tm_decode(tm);
+    if (tm->watch == NULL) return FALSE;
+  }
+  bit = 1 << (addr & 7);
+  if ( ((watch->bits[addr >> 3] & bit) != 0) == on ) return TRUE;
+  watch->bits[addr >> 3] ^= bit;
+  watch->count += on ? 1 : -1;
+  if (watch->count == 0) tm_watch_free(tm);
+  return TRUE;
+} /* tm_watch_set */
+
+/********************************************/
+int tm_watch_at (TMState * tm, int addr)
+{ TMWatch * watch = tm->watch;
+  return (watch != NULL) && (addr >= 0) && (addr < tm->dSize)
+         && WATCHED(watch->bits,addr);
+} /* tm_watch_at */
+
+/********************************************/
+void tm_watch_free (TMState * tm)
+{ TMWatch * watch = tm->watch;
+  if (watch == NULL) return;
+  munmap(watch->bits,watch->size);
+  free(watch->tMem);
+  free(watch);
+  tm->watch = NULL;
+} /* tm_watch_free */
@@ -0,0 +1,86 @@
+/****************************************************/
+/* File: tmbreak.h                                  */
+/* Breakpoints and watchpoints for the TM library   */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMBREAK_H_
+#define _TMBREAK_H_
+
+#include "tmvm.h"
+
+/* The breakpoints of a program. tm_run stops
+ * with srBREAK before executing an instruction
+ * at a breakpoint, except the first one of the
+ * run, so that running again carries on. The
+ * threaded engine has a trap handler patched
+ * into tMem at each of them, and the JIT ends
+ * its blocks there, so they cost nothing until
+ * one is reached. They belong to the program:
+ * machines made by tm_share see them too.
+ */
+typedef struct TMBreakRec
+   { char * at ;  /* iMemSize flags */
+     int count ;
+   } TMBreak;
+
+/* The watchpoints of a machine: a bit for each
+ * dMem word, mapped like dMem. A store (ST, PUSH,
+ * CALL, MCPY, MSET, VADD or VMUL) to a word with
+ * its bit set is done, and then tm_run stops
+ * with srWATCH, giving the address and the value
+ * it had before (the first such word of a
+ * block). The threaded engine runs tMem, a copy
+ * of the predecoded program where only the
+ * stores look at the bits, so the other
+ * instructions run at full speed; the JIT engine
+ * is replaced by it. They are dropped when the
+ * size of data memory changes, or tm_restore
+ * gives the machine another program.
+ */
+typedef struct TMWatchRec
+   { unsigned char * bits ; /* dSize bits */
+     int size ;  /* bytes mapped */
+     THREADEDINSTR * tMem ;
+     int count ;
+     int addr ;  /* the word last written */
+     int old ;   /* its value before */
+   } TMWatch;
+
+#define WATCHED(bits,m) ( (bits)[(m) >> 3] & (1 << ((m) & 7)) )
+
+/* Function tm_break_set sets (on TRUE) or clears
+ * the breakpoint at loc, and predecodes the
+ * program again. FALSE if loc is not in iMem or
+ * when out of memory.
+ */
+int tm_break_set (TMState * tm, int loc, int on);
+
+/* Function tm_break_at tells whether there is a
+ * breakpoint at loc
+ */
+int tm_break_at (TMState * tm, int loc);
+
+/* Procedure tm_break_free frees the breakpoints
+ * of a program
+ */
+void tm_break_free (TMBreak * brk);
+
+/* Function tm_watch_set sets (on TRUE) or clears
+ * the watchpoint on dMem[addr]. FALSE if addr is
+ * not in dMem or when out of memory.
+ */
+int tm_watch_set (TMState * tm, int addr, int on);
+
+/* Function tm_watch_at tells whether dMem[addr]
+ * is watched
+ */
+int tm_watch_at (TMState * tm, int addr);
+
+/* Procedure tm_watch_free drops the watchpoints
+ * of tm
+ */
+void tm_watch_free (TMState * tm);
+
+#endif
@@ -0,0 +1,38 @@
+/****************************************************/
+/* File: tmdecode.c                                 */
+/* Renders a binary TM trace (tm -t) as text, in    */
+/* the format of the t(race command                 */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tmtrace.h"
+
+int main (int argc, char * argv[])
+{ FILE * in;
+  int values = FALSE, i = 1;
+  if ( (argc > 1) && (strcmp(argv[1],"-v") == 0) )
+  { values = TRUE;
+    i++;
+  }
+  if (i != argc - 1)
+  { fprintf(stderr,"usage: %s [-v] <tracefile>\n",argv[0]);
+    fprintf(stderr,"   -v   add the value of reg(r) after each instruction\n"\
+                   "        and the dMem address (@) of LD and ST\n");
+    return 1;
+  }
+  in = fopen(argv[i],"rb");
+  if (in == NULL)
+  { fprintf(stderr,"trace file '%s' not found\n",argv[i]);
+    return 1;
+  }
+  if (! tm_trace_decode(in,stdout,values))
+  { fprintf(stderr,"'%s' is not a TM trace file\n",argv[i]);
+    return 1;
+  }
+  fclose(in);
+  return 0;
+} /* main */
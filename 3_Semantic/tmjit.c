@@ -0,0 +1,600 @@
+/****************************************************/
+/* File: tmjit.c                                    */
+/* x86-64 JIT engine for the TM library             */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "tmjit.h"
+#include "tmverify.h"
+#include "tmbreak.h"
+
+#if HAVE_JIT
+
+#include <sys/mman.h>
+
+/******* const *******/
+#define   JIT_CODESIZE  (1 << 20) /* bytes of machine code per machine */
+#define   JIT_MAXBLOCK  64        /* TM instructions per block */
+#define   JIT_BLOCKSIZE 8192      /* bytes of machine code per block */
+#define   JIT_CHECK     (-1)      /* result after a jump flagged VERIFY_CHECK */
+
+/* x86 registers used: eax and ecx are scratch,
+ * rdi holds tm, rsi the address of the
+ * instruction count, rdx the block table and r9
+ * tm->dMem, loaded on entry to every block
+ */
+#define   EAX  0
+#define   ECX  1
+
+#define   REGOFF   ((int) offsetof(TMState,reg))
+#define   DMEMOFF  ((int) offsetof(TMState,dMem))
+#define   PCOFF    (REGOFF + 4 * PC_REG)
+#define   NEXTOFF  ((int) offsetof(TMState,nextCheck))
+
+/******* type  *******/
+
+/* A compiled block is called as
+ *   result = block(tm, &count, table)
+ * It runs until an exit that is not compiled,
+ * or until count reaches tm->nextCheck (tested
+ * when going to another block), jumping
+ * straight from block to block through table, adds the instructions it executed to
+ * count and leaves the next location in
+ * reg[PC_REG], exactly as tm_step would. A
+ * return (LD pc) flagged VERIFY_CHECK ends the
+ * block with JIT_CHECK instead of srOKAY.
+ */
+typedef int (* JITCODE) (TMState * tm, int * count, void ** table);
+
+struct TMJitRec
+   { unsigned char * code ;  /* mmap'ed, JIT_CODESIZE bytes */
+     int used ;
+     unsigned char * exitStub ; /* returns srOKAY */
+     /* these have an entry for each iMem location */
+     /* table[loc]: the block starting at loc, or
+      * exitStub back to tm_jit_run */
+     void ** table ;
+     /* table of exitStub only: no chaining */
+     void ** noChain ;
+     /* entries into loc by way of tm_jit_run;
+      * -1 once loc cannot be compiled */
+     int * hits ;
+     TMState * shadow ; /* for tm->jitCheck */
+   };
+
+/* a block being compiled */
+typedef struct {
+      unsigned char buf [JIT_BLOCKSIZE] ;
+      int len ;
+      /* faults: rel32 to patch with the
+       * address of a stub returning code */
+      struct { int at ; int loc ; int count ; int code ; }
+        fault [JIT_MAXBLOCK] ;
+      int nfault ;
+      int iMemSize, dSize ; /* memory sizes of the machine */
+   } JITBLOCK;
+
+/********************************************/
+/* machine code emission */
+
+static void emit1 (JITBLOCK * b, int c)
+{ b->buf[b->len++] = (unsigned char) c;
+} /* emit1 */
+
+static void emit4 (JITBLOCK * b, int v)
+{ memcpy(b->buf + b->len,&v,4);
+  b->len += 4;
+} /* emit4 */
+
+/* op with the operand [rdi+disp] */
+static void emitMem (JITBLOCK * b, int op, int x86reg, int disp)
+{ emit1(b,op);
+  emit1(b,0x80 | (x86reg << 3) | 7);
+  emit4(b,disp);
+} /* emitMem */
+
+/* x86reg = reg[r]; the pc reads as loc+1 */
+static void loadReg (JITBLOCK * b, int x86reg, int r, int loc)
+{ if (r == PC_REG)
+  { emit1(b,0xB8 + x86reg);               /* mov r32,imm32 */
+    emit4(b,loc + 1);
+  }
+  else emitMem(b,0x8B,x86reg,REGOFF + 4 * r); /* mov r32,[rdi+d] */
+} /* loadReg */
+
+static void storeReg (JITBLOCK * b, int x86reg, int r)
+{ emitMem(b,0x89,x86reg,REGOFF + 4 * r);  /* mov [rdi+d],r32 */
+} /* storeReg */
+
+/* eax += d */
+static void addImm (JITBLOCK * b, int d)
+{ if (d == 0) return;
+  emit1(b,0x05);                          /* add eax,imm32 */
+  emit4(b,d);
+} /* addImm */
+
+/* count += n */
+static void addCount (JITBLOCK * b, int n)
+{ if (n == 0) return;
+  emit1(b,0x81);                          /* add dword [rsi],imm32 */
+  emit1(b,0x06);
+  emit4(b,n);
+} /* addCount */
+
+/* jcc to a fault stub: the instruction at loc
+ * failed with code, count instructions after the
+ * last addCount
+ */
+static void jumpFault (JITBLOCK * b, int cc, int loc, int count, int code)
+{ int f = b->nfault++;
+  emit1(b,0x0F);                          /* jcc rel32 */
+  emit1(b,0x80 | cc);
+  b->fault[f].at = b->len;
+  b->fault[f].loc = loc;
+  b->fault[f].count = count;
+  b->fault[f].code = code;
+  emit4(b,0);
+} /* jumpFault */
+
+/* skip the next n bytes if count has reached
+ * tm->nextCheck: tm_jit_run then looks at the
+ * limits of the run
+ */
+static void emitLimit (JITBLOCK * b, int n)
+{ emit1(b,0x8B);                          /* mov ecx,[rsi] */
+  emit1(b,0x0E);
+  emitMem(b,0x3B,ECX,NEXTOFF);            /* cmp ecx,[rdi+nextCheck] */
+  emit1(b,0x7D);                          /* jge +n */
+  emit1(b,n);
+} /* emitLimit */
+
+/* go to target: the block there, if any */
+static void emitGoto (JITBLOCK * b, int target)
+{ emitMem(b,0xC7,0,PCOFF);                /* mov dword [rdi+pc],imm32 */
+  emit4(b,target);
+  if ( (target >= 0) && (target < b->iMemSize) )
+  { emitLimit(b,6);
+    emit1(b,0xFF);                        /* jmp [rdx+target*8] */
+    emit1(b,0xA2);
+    emit4(b,target * 8);
+  }
+  emit1(b,0x31);                          /* xor eax,eax */
+  emit1(b,0xC0);
+  emit1(b,0xC3);                          /* ret */
+} /* emitGoto */
+
+/* go to the location in eax, known to be in
+ * iMem if the verifier says so in flags
+ */
+static void emitGotoEax (JITBLOCK * b, int flags)
+{ storeReg(b,EAX,PC_REG);
+  if (flags & VERIFY_JUMP)
+  { emitLimit(b,3);
+    emit1(b,0xFF);                        /* jmp [rdx+rax*8] */
+    emit1(b,0x24);
+    emit1(b,0xC2);
+    emit1(b,0x31);                        /* xor eax,eax */
+    emit1(b,0xC0);
+    emit1(b,0xC3);                        /* ret */
+    return;
+  }
+  emitLimit(b,10);
+  emit1(b,0x3D);                          /* cmp eax,iMemSize */
+  emit4(b,b->iMemSize);
+  emit1(b,0x73);                          /* jae +3 */
+  emit1(b,0x03);
+  emit1(b,0xFF);                          /* jmp [rdx+rax*8] */
+  emit1(b,0x24);
+  emit1(b,0xC2);
+  emit1(b,0x31);                          /* xor eax,eax */
+  emit1(b,0xC0);
+  emit1(b,0xC3);                          /* ret */
+} /* emitGotoEax */
+
+/* let tm_jit_run execute loc */
+static void emitReturn (JITBLOCK * b, int loc)
+{ emitMem(b,0xC7,0,PCOFF);
+  emit4(b,loc);
+  emit1(b,0x31);
+  emit1(b,0xC0);
+  emit1(b,0xC3);
+} /* emitReturn */
+
+/* fault unless the data address in eax is in dMem */
+static void checkAddress (JITBLOCK * b, int loc, int count)
+{ emit1(b,0x3D);                          /* cmp eax,dSize */
+  emit4(b,b->dSize);
+  jumpFault(b,0x03,loc,count,srDMEM_ERR); /* jae: also catches < 0 */
+} /* checkAddress */
+
+/* eax = the data address d+reg[s], checked
+ * unless the verifier says so in flags
+ */
+static void emitAddress (JITBLOCK * b, INSTRUCTION * in, int loc, int count,
+                         int flags)
+{ loadReg(b,EAX,in->iarg3,loc);
+  addImm(b,in->iarg2);
+  if (flags & VERIFY_MEM) return;
+  checkAddress(b,loc,count);
+} /* emitAddress */
+
+/********************************************/
+/* compileBlock translates the instructions from
+ * start to the first jump (CALL and RET too),
+ * HALT, IN, OUT, block instruction (MCPY to
+ * VMAX), breakpoint or jump flagged VERIFY_CHECK;
+ * conditional jumps that are not taken carry on
+ * in the block. FALSE if there is nothing to
+ * compile or no room for it.
+ */
+static int compileBlock (TMState * tm, struct TMJitRec * jit, int start)
+{ JITBLOCK block;
+  JITBLOCK * b = &block;
+  INSTRUCTION * in;
+  int loc, base = start, f, cc, r, s, flags;
+  b->len = 0;
+  b->nfault = 0;
+  b->iMemSize = tm->pgm->iMemSize;
+  b->dSize = tm->dSize;
+  emit1(b,0x4C);                          /* mov r9,[rdi+dMem] */
+  emitMem(b,0x8B,1,DMEMOFF);
+  for (loc = start; TRUE; loc++)
+  { if ( (loc - start == JIT_MAXBLOCK) || (loc == b->iMemSize) )
+    { addCount(b,loc - base);
+      emitGoto(b,loc);
+      break;
+    }
+    if ( (loc > start) && tm_break_at(tm,loc) )
+    { /* tm_jit_run stops there */
+      addCount(b,loc - base);
+      emitReturn(b,loc);
+      break;
+    }
+    in = &tm->pgm->iMem[loc];
+    r = in->iarg1;
+    s = in->iarg3;
+    flags = tm_verify_flags(tm,loc);
+    if (flags & VERIFY_CHECK)
+    { /* tm_jit_run checks where it lands */
+      if ( (in->iop == opLD) && (r == PC_REG) )
+      { emitAddress(b,in,loc,loc - base + 1,flags);
+        addCount(b,loc - base + 1);
+        emit1(b,0x41);                    /* mov eax,[r9+rax*4] */
+        emit1(b,0x8B);
+        emit1(b,0x04);
+        emit1(b,0x81);
+        storeReg(b,EAX,PC_REG);
+        emit1(b,0xB8);                    /* mov eax,JIT_CHECK */
+        emit4(b,JIT_CHECK);
+        emit1(b,0xC3);                    /* ret */
+        break;
+      }
+      if (loc == start) return FALSE;
+      addCount(b,loc - base);
+      emitReturn(b,loc);
+      break;
+    }
+    if ( (in->iop >= opJLT) && (in->iop <= opJNE) )
+    { /* jcc codes for the jump not being taken */
+      static const int notTaken[] =
+        { 0x8D, 0x8F, 0x8E, 0x8C, 0x85, 0x84 };
+      int skip;
+      addCount(b,loc - base + 1);
+      base = loc + 1;
+      loadReg(b,EAX,r,loc);
+      emit1(b,0x85);                      /* test eax,eax */
+      emit1(b,0xC0);
+      cc = notTaken[in->iop - opJLT];
+      emit1(b,0x0F);                      /* jcc past the jump */
+      emit1(b,cc);
+      skip = b->len;
+      emit4(b,0);
+      if (s == PC_REG) emitGoto(b,loc + 1 + in->iarg2);
+      else
+      { loadReg(b,EAX,s,loc);
+        addImm(b,in->iarg2);
+        emitGotoEax(b,flags);
+      }
+      f = b->len - skip - 4;
+      memcpy(b->buf + skip,&f,4);
+      continue;
+    }
+    if ( (r == PC_REG) && ((in->iop == opLDA) || (in->iop == opLDC)) )
+    { addCount(b,loc - base + 1);
+      if (in->iop == opLDC) emitGoto(b,in->iarg2);
+      else if (s == PC_REG) emitGoto(b,loc + 1 + in->iarg2);
+      else
+      { loadReg(b,EAX,s,loc);
+        addImm(b,in->iarg2);
+        emitGotoEax(b,flags);
+      }
+      break;
+    }
+    if (in->iop == opCALL)
+    { /* push the return address, then jump */
+      loadReg(b,EAX,r,loc);
+      checkAddress(b,loc,loc - base + 1);
+      addCount(b,loc - base + 1);
+      emit1(b,0x41);                      /* mov dword [r9+rax*4],imm32 */
+      emit1(b,0xC7);
+      emit1(b,0x04);
+      emit1(b,0x81);
+      emit4(b,loc + 1);
+      addImm(b,-1);
+      storeReg(b,EAX,r);
+      if (s == PC_REG) emitGoto(b,loc + 1 + in->iarg2);
+      else
+      { loadReg(b,EAX,s,loc);
+        /* the target is from before the push */
+        addImm(b,in->iarg2 + (s == r));
+        emitGotoEax(b,0);
+      }
+      break;
+    }
+    if (in->iop == opRET)
+    { loadReg(b,EAX,in->iarg2,loc);
+      addImm(b,1);
+      checkAddress(b,loc,loc - base + 1);
+      addCount(b,loc - base + 1);
+      storeReg(b,EAX,in->iarg2);
+      emit1(b,0x41);                      /* mov eax,[r9+rax*4] */
+      emit1(b,0x8B);
+      emit1(b,0x04);
+      emit1(b,0x81);
+      emitGotoEax(b,0);
+      break;
+    }
+    if ( (in->iop == opHALT) || (in->iop == opIN) || (in->iop == opOUT)
+         || ((in->iop >= opMCPY) && (in->iop <= opVMAX))
+         || (in->iop >= opRALim) || (in->iop == opRRLim)
+         || (in->iop == opRMLim)
+         || ((r == PC_REG) && (in->iop != opST)) )
+    { /* the interpreter does this one */
+      if (loc == start) return FALSE;
+      addCount(b,loc - base);
+      emitReturn(b,loc);
+      break;
+    }
+    switch (in->iop)
+    { case opADD :
+      case opSUB :
+      case opMUL :
+        loadReg(b,EAX,in->iarg2,loc);
+        loadReg(b,ECX,in->iarg3,loc);
+        if (in->iop == opADD)
+        { emit1(b,0x01); emit1(b,0xC8); } /* add eax,ecx */
+        else if (in->iop == opSUB)
+        { emit1(b,0x29); emit1(b,0xC8); } /* sub eax,ecx */
+        else
+        { emit1(b,0x0F); emit1(b,0xAF); emit1(b,0xC1); } /* imul eax,ecx */
+        storeReg(b,EAX,r);
+        break;
+      case opDIV :
+        loadReg(b,ECX,in->iarg3,loc);
+        emit1(b,0x85);                    /* test ecx,ecx */
+        emit1(b,0xC9);
+        jumpFault(b,0x04,loc,loc - base + 1,srZERODIVIDE);
+        loadReg(b,EAX,in->iarg2,loc);
+        /* idiv traps on the least int over -1:
+         * dividing by -1 negates, wrapping around */
+        emit1(b,0x83); emit1(b,0xF9); emit1(b,0xFF); /* cmp ecx,-1 */
+        emit1(b,0x75); emit1(b,0x04);     /* jne idiv */
+        emit1(b,0xF7); emit1(b,0xD8);     /* neg eax */
+        emit1(b,0xEB); emit1(b,0x09);     /* jmp past idiv */
+        /* cdq/idiv use edx: keep the table in r8 */
+        emit1(b,0x49); emit1(b,0x89); emit1(b,0xD0); /* mov r8,rdx */
+        emit1(b,0x99);                    /* cdq */
+        emit1(b,0xF7); emit1(b,0xF9);     /* idiv ecx */
+        emit1(b,0x4C); emit1(b,0x89); emit1(b,0xC2); /* mov rdx,r8 */
+        storeReg(b,EAX,r);
+        break;
+      case opLD :
+        emitAddress(b,in,loc,loc - base + 1,flags);
+        emit1(b,0x41);                    /* mov ecx,[r9+rax*4] */
+        emit1(b,0x8B);
+        emit1(b,0x0C);
+        emit1(b,0x81);
+        storeReg(b,ECX,r);
+        break;
+      case opST :
+        emitAddress(b,in,loc,loc - base + 1,flags);
+        loadReg(b,ECX,r,loc);
+        emit1(b,0x41);                    /* mov [r9+rax*4],ecx */
+        emit1(b,0x89);
+        emit1(b,0x0C);
+        emit1(b,0x81);
+        break;
+      case opPUSH :
+        loadReg(b,EAX,in->iarg2,loc);
+        checkAddress(b,loc,loc - base + 1);
+        loadReg(b,ECX,r,loc);
+        emit1(b,0x41);                    /* mov [r9+rax*4],ecx */
+        emit1(b,0x89);
+        emit1(b,0x0C);
+        emit1(b,0x81);
+        addImm(b,-1);
+        storeReg(b,EAX,in->iarg2);
+        break;
+      case opPOP :
+        loadReg(b,EAX,in->iarg2,loc);
+        addImm(b,1);
+        checkAddress(b,loc,loc - base + 1);
+        storeReg(b,EAX,in->iarg2);
+        emit1(b,0x41);                    /* mov ecx,[r9+rax*4] */
+        emit1(b,0x8B);
+        emit1(b,0x0C);
+        emit1(b,0x81);
+        storeReg(b,ECX,r);
+        break;
+      case opLDA :
+        loadReg(b,EAX,s,loc);
+        addImm(b,in->iarg2);
+        storeReg(b,EAX,r);
+        break;
+      case opLDC :
+        emitMem(b,0xC7,0,REGOFF + 4 * r); /* mov dword [rdi+d],imm32 */
+        emit4(b,in->iarg2);
+        break;
+    }
+  }
+  /* fault stubs: the pc and count tm_step leaves */
+  for (f = 0; f < b->nfault; f++)
+  { int rel = b->len - b->fault[f].at - 4;
+    memcpy(b->buf + b->fault[f].at,&rel,4);
+    emitMem(b,0xC7,0,PCOFF);
+    emit4(b,b->fault[f].loc + 1);
+    addCount(b,b->fault[f].count);
+    emit1(b,0xB8);                        /* mov eax,code */
+    emit4(b,b->fault[f].code);
+    emit1(b,0xC3);                        /* ret */
+  }
+  if (jit->used + b->len > JIT_CODESIZE) return FALSE;
+  memcpy(jit->code + jit->used,b->buf,b->len);
+  jit->table[start] = jit->code + jit->used;
+  jit->used += b->len;
+  return TRUE;
+} /* compileBlock */
+
+/********************************************/
+static void freeJit (struct TMJitRec * jit)
+{ if (jit->code != MAP_FAILED) munmap(jit->code,JIT_CODESIZE);
+  tm_destroy(jit->shadow);
+  free(jit->table);
+  free(jit->noChain);
+  free(jit->hits);
+  free(jit);
+} /* freeJit */
+
+/********************************************/
+static struct TMJitRec * newJit (int size)
+{ struct TMJitRec * jit;
+  int loc;
+  jit = (struct TMJitRec *) calloc(1,sizeof(struct TMJitRec));
+  if (jit == NULL) return NULL;
+  jit->code = (unsigned char *) mmap(NULL,JIT_CODESIZE,
+                  PROT_READ | PROT_WRITE | PROT_EXEC,
+                  MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+  jit->table = (void **) malloc(size * sizeof(void *));
+  jit->noChain = (void **) malloc(size * sizeof(void *));
+  jit->hits = (int *) calloc(size,sizeof(int));
+  if ( (jit->code == MAP_FAILED) || (jit->table == NULL)
+       || (jit->noChain == NULL) || (jit->hits == NULL) )
+  { freeJit(jit);
+    return NULL;
+  }
+  jit->exitStub = jit->code;
+  jit->code[0] = 0x31;                    /* xor eax,eax */
+  jit->code[1] = 0xC0;
+  jit->code[2] = 0xC3;                    /* ret */
+  jit->used = 16;
+  for (loc = 0; loc < size; loc++)
+    jit->table[loc] = jit->noChain[loc] = jit->exitStub;
+  return jit;
+} /* newJit */
+
+/********************************************/
+void tm_jit_free (TMState * tm)
+{ struct TMJitRec * jit = tm->jit;
+  if (jit == NULL) return;
+  freeJit(jit);
+  tm->jit = NULL;
+} /* tm_jit_free */
+
+/********************************************/
+/* checkBlock runs the block at pc by itself and
+ * then the same number of instructions with
+ * tm_step on a copy of the machine made before
+ */
+static int checkBlock (TMState * tm, struct TMJitRec * jit, int pc, int * count)
+{ TMState * sh;
+  int result, expect, stepResult = srOKAY, before = *count, i;
+  if (jit->shadow == NULL) jit->shadow = tm_share(tm);
+  sh = jit->shadow;
+  memcpy(sh->reg,tm->reg,sizeof(tm->reg));
+  memcpy(sh->dMem,tm->dMem,tm->dSize * sizeof(int));
+  result = ((JITCODE) jit->table[pc])(tm,count,jit->noChain);
+  expect = (result == JIT_CHECK) ? srOKAY : result;
+  for (i = before; (i < *count) && (stepResult == srOKAY); i++)
+    stepResult = tm_step(sh);
+  if ( (i != *count) || (stepResult != expect)
+       || (memcmp(sh->reg,tm->reg,sizeof(tm->reg)) != 0)
+       || (memcmp(sh->dMem,tm->dMem,tm->dSize * sizeof(int)) != 0) )
+  { fprintf(stderr,"jit: block at %d differs from tm_step "\
+            "after %d instructions (%s, expected %s)\n",
+            pc,*count - before,stepResultTab[expect],
+            stepResultTab[stepResult]);
+    abort();
+  }
+  return result;
+} /* checkBlock */
+
+/********************************************/
+STEPRESULT tm_jit_run (TMState * tm, int * icount)
+{ struct TMJitRec * jit = tm->jit;
+  STEPRESULT result = srOKAY;
+  TMVerify * verify = tm->pgm->verify;
+  int count = 0, pc, last, leave;
+  if (jit == NULL) jit = tm->jit = newJit(tm->pgm->iMemSize);
+  tm->fused = 0;
+  while (TRUE)
+  { pc = tm->reg[PC_REG];
+    if ( (count >= tm->nextCheck) && tm_limit(tm,count) )
+    { tm->iloc = pc;
+      result = srLIMIT;
+      break;
+    }
+    if ( (tm->pgm->brk != NULL) && tm_break_at(tm,pc) )
+    { tm->iloc = pc;
+      result = srBREAK;
+      break;
+    }
+    if ( (jit != NULL) && (pc >= 0) && (pc < tm->pgm->iMemSize) )
+    { if ( (jit->table[pc] == jit->exitStub) && (jit->hits[pc] >= 0)
+           && (++jit->hits[pc] >= JIT_THRESHOLD)
+           && ! compileBlock(tm,jit,pc) )
+        jit->hits[pc] = -1;
+      if (jit->table[pc] != jit->exitStub)
+      { if (tm->jitCheck)
+          result = checkBlock(tm,jit,pc,&count);
+        else
+          result = ((JITCODE) jit->table[pc])(tm,&count,jit->table);
+        if (result == (STEPRESULT) JIT_CHECK)
+        { result = srOKAY;
+          if (! tm_verify_entry(tm)) break;
+          continue;
+        }
+        if (result != srOKAY)
+        { tm->iloc = tm->reg[PC_REG] - 1;
+          break;
+        }
+        continue;
+      }
+    }
+    /* interpret up to the next jump, or until one
+     * leaves the verified states: tm_run carries on */
+    do
+    { last = tm->reg[PC_REG];
+      result = tm_step(tm);
+      count++;
+      leave = (result == srOKAY) && (verify != NULL) && (last < verify->size)
+              && (verify->flags[last] & VERIFY_CHECK) && ! tm_verify_entry(tm);
+    } while ( (result == srOKAY) && ! leave && (tm->reg[PC_REG] == last + 1)
+              && ((tm->pgm->brk == NULL) || ! tm_break_at(tm,last + 1)) );
+    if ( (result != srOKAY) || leave ) break;
+  }
+  *icount = count;
+  return result;
+} /* tm_jit_run */
+
+#else
+
+/********************************************/
+void tm_jit_free (TMState * tm)
+{
+} /* tm_jit_free */
+
+#endif
@@ -0,0 +1,37 @@
+/****************************************************/
+/* File: tmjit.h                                    */
+/* x86-64 JIT engine for the TM library: hot basic  */
+/* blocks are translated to machine code            */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMJIT_H_
+#define _TMJIT_H_
+
+#include "tmvm.h"
+
+/* number of entries into a block, by way of the
+ * interpreter, before it is compiled
+ */
+#define JIT_THRESHOLD 16
+
+/* Function tm_jit_run executes like tm_run,
+ * compiling blocks of tm's program as they get
+ * hot and interpreting the rest with tm_step.
+ * It returns srOKAY when a jump flagged
+ * VERIFY_CHECK lands in a state the verifier
+ * does not cover, for tm_run to carry on.
+ * With tm->jitCheck set, every compiled block is
+ * checked against tm_step on a copy of the
+ * machine; a difference is reported on stderr
+ * and aborts the program.
+ */
+STEPRESULT tm_jit_run (TMState * tm, int * icount);
+
+/* Procedure tm_jit_free drops the compiled code
+ * of tm, as when its program changes
+ */
+void tm_jit_free (TMState * tm);
+
+#endif
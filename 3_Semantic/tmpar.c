@@ -0,0 +1,369 @@
+/****************************************************/
+/* File: tmpar.c                                    */
+/* Parallel runner for the TM library               */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "tmpar.h"
+
+/* Each worker owns the jobs lo..hi-1 of a
+ * contiguous range. It takes its own work from
+ * the front; an idle worker steals the back half
+ * of the largest range left. Ranges only shrink,
+ * so when every range is empty all jobs are taken.
+ */
+typedef struct WorkerRec {
+      pthread_t thread ;
+      pthread_mutex_t lock ;
+      int lo, hi ;
+      TMState * tm ;
+      TMSnapshot * start ; /* state at the first IN */
+      int startCount ;     /* instructions up to it */
+      TMJob * jobs ;
+      struct WorkerRec * all ;
+      int nworkers ;
+   } WORKER;
+
+/* What a child of tm_fork_jobs sends back,
+ * followed by the outCount OUT values
+ */
+typedef struct {
+      STEPRESULT result ;
+      int icount ;
+      int iloc ;
+      int outCount ;
+   } FORKREPLY;
+
+/********************************************/
+/* runToInput runs tm with tm_step until the next
+ * instruction is an IN, and gives srOKAY, or
+ * until the program ends first. *icount gets the
+ * number of steps. All the runs of a program do
+ * the same up to there, so it is done only once;
+ * it counts towards the step limit of each run,
+ * which it leaves some of if it gives srOKAY.
+ */
+static STEPRESULT runToInput (TMState * tm, int * icount)
+{ STEPRESULT result;
+  int pc;
+  *icount = 0;
+  tm_limit_start(tm);
+  while (TRUE)
+  { pc = tm->reg[PC_REG];
+    if ( (*icount >= tm->nextCheck) && tm_limit(tm,*icount) )
+    { tm->iloc = pc;
+      return srLIMIT;
+    }
+    if ( (pc >= 0) && (pc < tm->pgm->iMemSize)
+         && (tm->pgm->iMem[pc].iop == opIN) )
+      return srOKAY;
+    result = tm_step(tm);
+    (*icount)++;
+    if (result != srOKAY) return result;
+  }
+} /* runToInput */
+
+/********************************************/
+/* runFrom runs tm, which is at the first IN
+ * after startCount steps, for the steps of the
+ * limit left, and gives the count of the whole
+ * run in *icount
+ */
+static STEPRESULT runFrom (TMState * tm, int startCount, int * icount)
+{ STEPRESULT result;
+  int maxSteps = tm->maxSteps;
+  if (maxSteps > 0) tm->maxSteps = maxSteps - startCount;
+  *icount = 0;
+  result = tm_run(tm,icount);
+  *icount += startCount;
+  tm->maxSteps = maxSteps;
+  return result;
+} /* runFrom */
+
+/********************************************/
+/* endJob sets job to the end of a run of tm */
+static void endJob (TMState * tm, TMJob * job, STEPRESULT result, int icount)
+{ job->result = result;
+  job->icount = icount;
+  job->iloc = tm->iloc;
+  job->outCount = tm->outCount;
+  job->outVals = NULL;
+  if (tm->outCount > 0)
+  { job->outVals = (int *) malloc(tm->outCount * sizeof(int));
+    if (job->outVals == NULL) job->outCount = 0;
+    else memcpy(job->outVals,tm->outVals,tm->outCount * sizeof(int));
+  }
+} /* endJob */
+
+/********************************************/
+/* startJobs makes a machine sharing the program
+ * of tm and runs it up to the first IN. If the
+ * program ends before, every job gets that end
+ * and *start is NULL. FALSE if out of memory.
+ */
+static int startJobs (TMState * tm, TMJob * jobs, int n,
+                      TMState ** start, int * startCount)
+{ STEPRESULT result;
+  int i;
+  *start = tm_share(tm);
+  if (*start == NULL) return FALSE;
+  tm_set_input(*start,NULL,0);
+  result = runToInput(*start,startCount);
+  if (result != srOKAY)
+  { for (i = 0; i < n; i++)
+      endJob(*start,&jobs[i],result,*startCount);
+    tm_destroy(*start);
+    *start = NULL;
+  }
+  return TRUE;
+} /* startJobs */
+
+/********************************************/
+/* takeJob gives the next job of w, or -1 */
+static int takeJob (WORKER * w)
+{ int j = -1;
+  pthread_mutex_lock(&w->lock);
+  if (w->lo < w->hi) j = w->lo++;
+  pthread_mutex_unlock(&w->lock);
+  return j;
+} /* takeJob */
+
+/********************************************/
+/* stealJobs moves the back half of the largest
+ * other range into w; FALSE if nothing is left
+ */
+static int stealJobs (WORKER * w, WORKER * all, int n)
+{ int i, best, size, lo = 0, hi = 0;
+  do
+  { best = -1;
+    size = 0;
+    for (i = 0; i < n; i++)
+    { int left;
+      if (&all[i] == w) continue;
+      pthread_mutex_lock(&all[i].lock);
+      left = all[i].hi - all[i].lo;
+      pthread_mutex_unlock(&all[i].lock);
+      if (left > size)
+      { best = i;
+        size = left;
+      }
+    }
+    if (best < 0) return FALSE;
+    /* the range may have shrunk since */
+    pthread_mutex_lock(&all[best].lock);
+    size = all[best].hi - all[best].lo;
+    if (size > 0)
+    { hi = all[best].hi;
+      lo = hi - (size + 1) / 2;
+      all[best].hi = lo;
+    }
+    pthread_mutex_unlock(&all[best].lock);
+  } while (size <= 0);
+  pthread_mutex_lock(&w->lock);
+  w->lo = lo;
+  w->hi = hi;
+  pthread_mutex_unlock(&w->lock);
+  return TRUE;
+} /* stealJobs */
+
+/********************************************/
+/* runJob runs job from the first IN */
+static void runJob (WORKER * w, TMJob * job)
+{ TMState * tm = w->tm;
+  STEPRESULT result;
+  int icount, startCount = w->startCount;
+  if (! tm_restore(tm,w->start))
+  { /* out of memory: from the start */
+    tm_reset(tm);
+    startCount = 0;
+  }
+  tm_set_input(tm,job->inVals,job->inCount);
+  result = runFrom(tm,startCount,&icount);
+  endJob(tm,job,result,icount);
+} /* runJob */
+
+/********************************************/
+static void * workerMain (void * arg)
+{ WORKER * w = (WORKER *) arg;
+  int j;
+  do
+    while ( (j = takeJob(w)) >= 0 )
+      runJob(w,&w->jobs[j]);
+  while (stealJobs(w,w->all,w->nworkers));
+  return NULL;
+} /* workerMain */
+
+/********************************************/
+int tm_run_jobs (TMState * tm, TMJob * jobs, int n, int nthreads)
+{ WORKER * all;
+  TMState * first;
+  TMSnapshot * start;
+  int i, started = 0, ok = TRUE, startCount;
+  if (nthreads > n) nthreads = n;
+  if (nthreads < 1) nthreads = 1;
+  if (! startJobs(tm,jobs,n,&first,&startCount)) return FALSE;
+  if (first == NULL) return TRUE;
+  start = tm_snapshot(first);
+  tm_destroy(first);
+  all = (WORKER *) calloc(nthreads,sizeof(WORKER));
+  if ( (all == NULL) || (start == NULL) )
+  { free(all);
+    tm_snapshot_free(start);
+    return FALSE;
+  }
+  /* machines are made here: tm_share is not thread safe */
+  for (i = 0; i < nthreads; i++)
+  { all[i].tm = tm_share(tm);
+    if (all[i].tm == NULL) ok = FALSE;
+    pthread_mutex_init(&all[i].lock,NULL);
+    all[i].lo = (int) ((long) n * i / nthreads);
+    all[i].hi = (int) ((long) n * (i + 1) / nthreads);
+    all[i].start = start;
+    all[i].startCount = startCount;
+    all[i].jobs = jobs;
+    all[i].all = all;
+    all[i].nworkers = nthreads;
+  }
+  /* the calling thread is worker 0; if a thread
+   * cannot be started the others steal its jobs */
+  for (i = 1; ok && (i < nthreads); i++)
+  { if (pthread_create(&all[i].thread,NULL,workerMain,&all[i]) != 0)
+      break;
+    started = i;
+  }
+  if (ok) workerMain(&all[0]);
+  for (i = 1; i <= started; i++)
+    pthread_join(all[i].thread,NULL);
+  for (i = 0; i < nthreads; i++)
+  { tm_destroy(all[i].tm);
+    pthread_mutex_destroy(&all[i].lock);
+  }
+  free(all);
+  tm_snapshot_free(start);
+  return ok;
+} /* tm_run_jobs */
+
+/********************************************/
+/* readAll reads n bytes from fd; FALSE if the
+ * writer went away first
+ */
+static int readAll (int fd, void * buf, size_t n)
+{ ssize_t got;
+  while (n > 0)
+  { got = read(fd,buf,n);
+    if (got <= 0) return FALSE;
+    buf = (char *) buf + got;
+    n -= got;
+  }
+  return TRUE;
+} /* readAll */
+
+/********************************************/
+static int writeAll (int fd, void * buf, size_t n)
+{ ssize_t put;
+  while (n > 0)
+  { put = write(fd,buf,n);
+    if (put <= 0) return FALSE;
+    buf = (char *) buf + put;
+    n -= put;
+  }
+  return TRUE;
+} /* writeAll */
+
+/********************************************/
+/* forkJob runs job in a child of the process,
+ * from the state of tm, and gives the pid, or -1;
+ * *fd gets the end of the pipe of its reply
+ */
+static pid_t forkJob (TMState * tm, TMJob * job, int startCount, int * fd)
+{ FORKREPLY reply;
+  int ends[2];
+  pid_t pid;
+  if (pipe(ends) != 0) return -1;
+  pid = fork();
+  if (pid != 0)
+  { close(ends[1]);
+    if (pid < 0) close(ends[0]);
+    *fd = ends[0];
+    return pid;
+  }
+  /* the child: tm is its own copy */
+  close(ends[0]);
+  tm_set_input(tm,job->inVals,job->inCount);
+  reply.result = runFrom(tm,startCount,&reply.icount);
+  reply.iloc = tm->iloc;
+  reply.outCount = tm->outCount;
+  if ( ! writeAll(ends[1],&reply,sizeof(reply))
+       || ! writeAll(ends[1],tm->outVals,tm->outCount * sizeof(int)) )
+    _exit(1);
+  _exit(0);
+} /* forkJob */
+
+/********************************************/
+/* readReply fills job from the reply on fd */
+static int readReply (int fd, TMJob * job)
+{ FORKREPLY reply;
+  if (! readAll(fd,&reply,sizeof(reply))) return FALSE;
+  job->result = reply.result;
+  job->icount = reply.icount;
+  job->iloc = reply.iloc;
+  job->outCount = reply.outCount;
+  job->outVals = NULL;
+  if (reply.outCount > 0)
+  { job->outVals = (int *) malloc(reply.outCount * sizeof(int));
+    if ( (job->outVals == NULL)
+         || ! readAll(fd,job->outVals,reply.outCount * sizeof(int)) )
+    { free(job->outVals);
+      job->outVals = NULL;
+      job->outCount = 0;
+      return FALSE;
+    }
+  }
+  return TRUE;
+} /* readReply */
+
+/********************************************/
+int tm_fork_jobs (TMState * tm, TMJob * jobs, int n, int nprocs)
+{ TMState * first;
+  pid_t * pids;
+  int * fds;
+  int next = 0, done = 0, ok = TRUE, startCount, status;
+  if (nprocs < 1) nprocs = 1;
+  if (! startJobs(tm,jobs,n,&first,&startCount)) return FALSE;
+  if (first == NULL) return TRUE;
+  pids = (pid_t *) malloc(n * sizeof(pid_t));
+  fds = (int *) malloc(n * sizeof(int));
+  if ( (pids == NULL) || (fds == NULL) ) ok = FALSE;
+  /* replies are read in job order; a child that
+   * is not read yet waits only when its pipe is
+   * full, and the oldest is always being read */
+  while ( ok && (done < n) )
+  { while ( ok && (next < n) && (next - done < nprocs) )
+    { pids[next] = forkJob(first,&jobs[next],startCount,&fds[next]);
+      if (pids[next] < 0) ok = FALSE;
+      else next++;
+    }
+    if (done == next) break;
+    if (! readReply(fds[done],&jobs[done])) ok = FALSE;
+    close(fds[done]);
+    if ( (waitpid(pids[done],&status,0) != pids[done])
+         || ! WIFEXITED(status) || (WEXITSTATUS(status) != 0) )
+      ok = FALSE;
+    done++;
+  }
+  /* after a failure: collect the children left */
+  for (; done < next; done++)
+  { close(fds[done]);
+    waitpid(pids[done],&status,0);
+  }
+  free(pids);
+  free(fds);
+  tm_destroy(first);
+  return ok;
+} /* tm_fork_jobs */
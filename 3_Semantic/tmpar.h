@@ -0,0 +1,52 @@
+/****************************************************/
+/* File: tmpar.h                                    */
+/* Parallel runner: one TM program run against many */
+/* input sets by a pool of work-stealing threads    */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMPAR_H_
+#define _TMPAR_H_
+
+#include "tmvm.h"
+
+/* One run of the program. inVals/inCount are
+ * filled in by the caller; the rest is set by
+ * tm_run_jobs. outVals is malloc'ed (NULL when
+ * there was no output) and belongs to the caller.
+ */
+typedef struct {
+      int * inVals ;
+      int inCount ;
+      int * outVals ;
+      int outCount ;
+      STEPRESULT result ;
+      int icount ;
+      int iloc ;  /* where the run stopped */
+   } TMJob;
+
+/* Function tm_run_jobs runs the program of tm
+ * once for each of the n jobs, on nthreads
+ * threads each with its own registers and data
+ * memory; iMem is shared. tm itself is not run.
+ * The part of the run before the first IN is the
+ * same for every job: it is run once, and each
+ * job starts from a snapshot taken there. Its
+ * steps count towards the tm->maxSteps of each
+ * job, as in a run of its own.
+ * Returns FALSE if the threads could not be set up.
+ */
+int tm_run_jobs (TMState * tm, TMJob * jobs, int n, int nthreads);
+
+/* Function tm_fork_jobs runs the jobs like
+ * tm_run_jobs, but in child processes, nprocs at
+ * a time: the program is run up to its first IN,
+ * and each job is finished by a child forked from
+ * there, sharing memory with the parent until it
+ * writes to it. Returns FALSE if a child could
+ * not be started or did not finish.
+ */
+int tm_fork_jobs (TMState * tm, TMJob * jobs, int n, int nprocs);
+
+#endif
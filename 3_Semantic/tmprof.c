@@ -0,0 +1,244 @@
+/****************************************************/
+/* File: tmprof.c                                   */
+/* Execution profiler for the TM library            */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "tmprof.h"
+
+/* One line of a report part: the counts of a
+ * source line, function or location (key)
+ */
+typedef struct {
+      unsigned long count ;
+      unsigned long taken ;
+      int key ;
+   } HOTSPOT;
+
+/* A line table read back: source line of each
+ * location (0 if unknown), and its function as
+ * an index into names (-1 if none)
+ */
+typedef struct {
+      int * line ;
+      int * func ;
+      char ** names ;
+      int nnames ;
+      int maxLine ;
+   } LINETABLE;
+
+/********************************************/
+int tm_profile_start (TMState * tm)
+{ TMProfile * prof = tm->prof;
+  int size = tm->pgm->iMemSize;
+  if ( (prof == NULL)
+       && ((prof = (TMProfile *) calloc(1,sizeof(TMProfile))) == NULL) )
+    return FALSE;
+  tm->prof = prof;
+  if (prof->size != size)
+  { free(prof->count);
+    free(prof->taken);
+    prof->count = (unsigned long *) malloc(size * sizeof(unsigned long));
+    prof->taken = (unsigned long *) malloc(size * sizeof(unsigned long));
+    prof->size = size;
+    if ( (prof->count == NULL) || (prof->taken == NULL) )
+    { tm_profile_stop(tm);
+      return FALSE;
+    }
+  }
+  memset(prof->count,0,size * sizeof(unsigned long));
+  memset(prof->taken,0,size * sizeof(unsigned long));
+  return TRUE;
+} /* tm_profile_start */
+
+/********************************************/
+void tm_profile_stop (TMState * tm)
+{ if (tm->prof == NULL) return;
+  free(tm->prof->count);
+  free(tm->prof->taken);
+  free(tm->prof);
+  tm->prof = NULL;
+} /* tm_profile_stop */
+
+/********************************************/
+/* readLines fills t from the line table file
+ * name, for size locations; FALSE if it cannot
+ * be read
+ */
+static int readLines (LINETABLE * t, char * name, int size)
+{ FILE * in;
+  char buf[LINESIZE], func[LINESIZE];
+  int loc, line, k;
+  t->names = NULL;
+  t->nnames = 0;
+  t->maxLine = 0;
+  if ( (name == NULL) || ((in = fopen(name,"r")) == NULL) ) return FALSE;
+  t->line = (int *) calloc(size,sizeof(int));
+  t->func = (int *) malloc(size * sizeof(int));
+  if ( (t->line == NULL) || (t->func == NULL) )
+  { free(t->line);
+    free(t->func);
+    fclose(in);
+    return FALSE;
+  }
+  for (loc = 0; loc < size; loc++) t->func[loc] = -1;
+  while (fgets(buf,LINESIZE,in) != NULL)
+  { if ( (buf[0] == '*')
+         || (sscanf(buf,"%d %d %s",&loc,&line,func) != 3)
+         || (loc < 0) || (loc >= size) || (line <= 0) )
+      continue;
+    t->line[loc] = line;
+    if (line > t->maxLine) t->maxLine = line;
+    if (strcmp(func,"-") == 0) continue;
+    /* locations of a function come together */
+    for (k = t->nnames - 1; k >= 0; k--)
+      if (strcmp(t->names[k],func) == 0) break;
+    if (k < 0)
+    { char ** names = (char **) realloc(t->names,
+                                  (t->nnames + 1) * sizeof(char *));
+      if (names == NULL) break;
+      t->names = names;
+      if ((names[t->nnames] = (char *) malloc(strlen(func) + 1)) == NULL)
+        break;
+      strcpy(names[t->nnames],func);
+      k = t->nnames++;
+    }
+    t->func[loc] = k;
+  }
+  fclose(in);
+  return TRUE;
+} /* readLines */
+
+/********************************************/
+static void freeLines (LINETABLE * t)
+{ int k;
+  for (k = 0; k < t->nnames; k++) free(t->names[k]);
+  free(t->names);
+  free(t->line);
+  free(t->func);
+} /* freeLines */
+
+/********************************************/
+/* hottest first; ties in key order */
+static int compareSpots (const void * a, const void * b)
+{ const HOTSPOT * x = (const HOTSPOT *) a;
+  const HOTSPOT * y = (const HOTSPOT *) b;
+  if (x->count != y->count) return (x->count < y->count) ? 1 : -1;
+  return (x->key > y->key) - (x->key < y->key);
+} /* compareSpots */
+
+/********************************************/
+static double percent (unsigned long n, unsigned long total)
+{ return total ? 100.0 * n / total : 0.0;
+} /* percent */
+
+/********************************************/
+/* funcName gives the function of location loc */
+static char * funcName (LINETABLE * t, int loc)
+{ if ( (t->func == NULL) || (t->func[loc] < 0) ) return "-";
+  return t->names[t->func[loc]];
+} /* funcName */
+
+/********************************************/
+int tm_profile_report (TMState * tm, FILE * out, char * lineName,
+                       FILE * data)
+{ TMProfile * prof = tm->prof;
+  LINETABLE t;
+  HOTSPOT * spots;
+  unsigned long total = 0;
+  int haveLines, n, k, loc, nspots;
+  if (prof == NULL) return TRUE;
+  memset(&t,0,sizeof(t));
+  haveLines = readLines(&t,lineName,prof->size);
+  n = prof->size;
+  if (haveLines && (t.maxLine + 1 > n)) n = t.maxLine + 1;
+  if (t.nnames > n) n = t.nnames;
+  spots = (HOTSPOT *) calloc(n,sizeof(HOTSPOT));
+  if (spots == NULL)
+  { fprintf(out,"out of memory for the profile report\n");
+    freeLines(&t);
+    return TRUE;
+  }
+  for (loc = 0; loc < prof->size; loc++) total += prof->count[loc];
+  fprintf(out,"Profile: %lu instructions executed\n",total);
+
+  if (haveLines)
+  { /* source lines: all the locations of each line */
+    for (k = 0; k <= t.maxLine; k++) spots[k].key = k;
+    for (loc = 0; loc < prof->size; loc++)
+    { spots[t.line[loc]].count += prof->count[loc];
+      spots[t.line[loc]].taken += prof->taken[loc];
+    }
+    qsort(spots,t.maxLine + 1,sizeof(HOTSPOT),compareSpots);
+    fprintf(out,"Hottest source lines:\n");
+    fprintf(out,"%12s %6s %12s %6s  %s\n","count","%","taken","line",
+            "function");
+    for (k = 0; (k <= t.maxLine) && (k < PROFILE_TOP)
+                && (spots[k].count > 0); k++)
+    { /* the function of the first location of the line */
+      for (loc = 0; (loc < prof->size) && (t.line[loc] != spots[k].key); loc++)
+        ;
+      fprintf(out,"%12lu %5.1f%% %12lu ",spots[k].count,
+              percent(spots[k].count,total),spots[k].taken);
+      /* line 0: code not from any line (prelude) */
+      if (spots[k].key > 0) fprintf(out,"%6d  ",spots[k].key);
+      else fprintf(out,"%6s  ","-");
+      fprintf(out,"%s\n",spots[k].key > 0 ? funcName(&t,loc) : "-");
+    }
+
+    /* functions */
+    memset(spots,0,n * sizeof(HOTSPOT));
+    for (k = 0; k < t.nnames; k++) spots[k].key = k;
+    nspots = t.nnames;
+    for (loc = 0; loc < prof->size; loc++)
+      if (t.func[loc] >= 0)
+      { spots[t.func[loc]].count += prof->count[loc];
+        spots[t.func[loc]].taken += prof->taken[loc];
+      }
+    qsort(spots,nspots,sizeof(HOTSPOT),compareSpots);
+    if (nspots > 0)
+    { fprintf(out,"By function:\n");
+      fprintf(out,"%12s %6s %12s  %s\n","count","%","taken","function");
+    }
+    for (k = 0; k < nspots; k++)
+      fprintf(out,"%12lu %5.1f%% %12lu  %s\n",spots[k].count,
+              percent(spots[k].count,total),spots[k].taken,
+              t.names[spots[k].key]);
+  }
+
+  /* locations */
+  memset(spots,0,n * sizeof(HOTSPOT));
+  for (loc = 0; loc < prof->size; loc++)
+  { spots[loc].count = prof->count[loc];
+    spots[loc].taken = prof->taken[loc];
+    spots[loc].key = loc;
+  }
+  qsort(spots,prof->size,sizeof(HOTSPOT),compareSpots);
+  fprintf(out,"Hottest locations:\n");
+  fprintf(out,"%12s %6s %12s %6s  %s\n","count","%","taken","line",
+          "instruction");
+  for (k = 0; (k < prof->size) && (k < PROFILE_TOP)
+              && (spots[k].count > 0); k++)
+  { loc = spots[k].key;
+    fprintf(out,"%12lu %5.1f%% %12lu ",spots[k].count,
+            percent(spots[k].count,total),spots[k].taken);
+    if (haveLines && (t.line[loc] > 0)) fprintf(out,"%6d  ",t.line[loc]);
+    else fprintf(out,"%6s  ","-");
+    tm_write_instruction(tm,out,loc);
+  }
+  free(spots);
+
+  if (data != NULL)
+  { fprintf(data,"* TM profile: location count taken source-line function\n");
+    for (loc = 0; loc < prof->size; loc++)
+      if (prof->count[loc] > 0)
+        fprintf(data,"%d %lu %lu %d %s\n",loc,prof->count[loc],
+                prof->taken[loc],haveLines ? t.line[loc] : 0,
+                haveLines ? funcName(&t,loc) : "-");
+  }
+  freeLines(&t);
+  return (data == NULL) || ! ferror(data);
+} /* tm_profile_report */
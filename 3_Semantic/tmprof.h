@@ -0,0 +1,53 @@
+/****************************************************/
+/* File: tmprof.h                                   */
+/* Execution profiler for the TM library: counts    */
+/* per iMem location, reported by source line       */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMPROF_H_
+#define _TMPROF_H_
+
+#include "tmvm.h"
+
+/* number of lines in each part of the report */
+#define PROFILE_TOP 20
+
+/* Counts for the iMemSize locations of the
+ * program: how often each was executed, and how
+ * often it changed the pc to something other
+ * than the next location (a taken jump)
+ */
+typedef struct TMProfileRec
+   { int size ;
+     unsigned long * count ;
+     unsigned long * taken ;
+   } TMProfile;
+
+/* Function tm_profile_start clears the counts and
+ * starts counting; while tm->prof is set tm_run
+ * executes with tm_step. tm_load restarts it for
+ * the new program. Returns FALSE if out of memory.
+ */
+int tm_profile_start (TMState * tm);
+
+/* Procedure tm_profile_stop stops counting and
+ * frees the counts
+ */
+void tm_profile_stop (TMState * tm);
+
+/* Function tm_profile_report writes to out the
+ * hottest source lines, functions and locations.
+ * lineName is a line table (.tml) written by the
+ * compiler, giving the source line and function
+ * of each location; without it (NULL, or not
+ * readable) only locations are reported. If data
+ * is not NULL it gets a line "loc count taken
+ * line function" for each location executed.
+ * Returns FALSE if data could not be written.
+ */
+int tm_profile_report (TMState * tm, FILE * out, char * lineName,
+                       FILE * data);
+
+#endif
@@ -0,0 +1,243 @@
+/****************************************************/
+/* File: tmrev.c                                    */
+/* Reverse execution for the TM library             */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "tmrev.h"
+
+/* Going back a few steps undoes them from the
+ * log. Going back further restores the last
+ * checkpoint before the step wanted and runs
+ * forward to it again with tm_step, which is
+ * fast enough for millions of steps, refilling
+ * the log on the way.
+ */
+
+/********************************************/
+/* revInput is IN while recording: the value
+ * read the first time through, or a new one,
+ * which is kept
+ */
+static int revInput (TMState * tm, int * value)
+{ TMRev * rev = tm->rev;
+  if (rev->inNow < rev->ninputs)
+  { *value = rev->inputs[rev->inNow++];
+    return TRUE;
+  }
+  if (rev->ninputs == rev->inCap)
+  { long cap = rev->inCap ? 2 * rev->inCap : 256;
+    int * vals = (int *) realloc(rev->inputs,cap * sizeof(int));
+    if (vals == NULL) return FALSE; /* as if there were no input */
+    rev->inputs = vals;
+    rev->inCap = cap;
+  }
+  if (rev->input != NULL)
+  { if (! rev->input(tm,value)) return FALSE;
+  }
+  else if (tm->inPos < tm->inCount)
+    *value = tm->inVals[tm->inPos++];
+  else
+  { /* nothing read: nothing for undo to give back */
+    rev->log[(rev->steps - 1) % UNDO_RECORDS].where = -1;
+    return FALSE;
+  }
+  rev->inputs[rev->ninputs++] = *value;
+  rev->inNow++;
+  return TRUE;
+} /* revInput */
+
+/********************************************/
+/* revOutput is OUT while recording: quiet when
+ * running forward again to a step gone back to
+ */
+static void revOutput (TMState * tm, int v)
+{ TMRev * rev = tm->rev;
+  if (rev->output != NULL)
+  { if (! rev->replaying) rev->output(tm,v);
+    return;
+  }
+  if (tm->outCount == tm->outCap)
+  { int cap = tm->outCap ? 2 * tm->outCap : 256;
+    int * vals = (int *) realloc(tm->outVals,cap * sizeof(int));
+    if (vals == NULL) return;
+    tm->outVals = vals;
+    tm->outCap = cap;
+  }
+  tm->outVals[tm->outCount++] = v;
+} /* revOutput */
+
+/********************************************/
+/* checkpoint saves the state at the current step */
+static void checkpoint (TMState * tm)
+{ TMRev * rev = tm->rev;
+  TMSnapshot * snap;
+  int k, j;
+  if (rev->ncp == MAX_CHECKPOINTS)
+  { rev->spacing *= 2;
+    for (k = j = 0; k < rev->ncp; k++)
+      if (rev->cp[k].steps % rev->spacing == 0) rev->cp[j++] = rev->cp[k];
+      else tm_snapshot_free(rev->cp[k].snap);
+    rev->ncp = j;
+    if (rev->steps % rev->spacing != 0) return;
+  }
+  /* out of memory: going back just takes longer */
+  if ((snap = tm_snapshot(tm)) == NULL) return;
+  rev->cp[rev->ncp].steps = rev->steps;
+  rev->cp[rev->ncp].inputs = rev->inNow;
+  rev->cp[rev->ncp++].snap = snap;
+} /* checkpoint */
+
+/********************************************/
+UNDOREC * tm_rev_record (TMState * tm, int pc)
+{ TMRev * rev = tm->rev;
+  UNDOREC * undo;
+  if ( (rev->steps % rev->spacing == 0)
+       && (rev->cp[rev->ncp - 1].steps < rev->steps) )
+    checkpoint(tm);
+  undo = &rev->log[rev->steps % UNDO_RECORDS];
+  rev->steps++;
+  if (rev->steps - rev->logFirst > UNDO_RECORDS)
+    rev->logFirst = rev->steps - UNDO_RECORDS;
+  undo->pc = pc;
+  undo->where = -1;
+  return undo;
+} /* tm_rev_record */
+
+/********************************************/
+/* undo takes back the last step */
+static void undo (TMState * tm)
+{ TMRev * rev = tm->rev;
+  UNDOREC * undo = &rev->log[--rev->steps % UNDO_RECORDS];
+  INSTRUCTION * in = &tm->pgm->iMem[undo->pc];
+  int op = in->iop;
+  if (undo->where >= NO_REGS) tm->dMem[undo->where - NO_REGS] = undo->old;
+  else if (undo->where >= 0) tm->reg[undo->where] = undo->old;
+  /* the stack pointer moved by one, if the step ran */
+  if (undo->where >= 0)
+  { if ( (op == opPUSH) || (op == opCALL) ) tm->reg[tm_stack_reg(in)]++;
+    else if ( (op == opRET) || ((op == opPOP) && (in->iarg1 != in->iarg2)) )
+      tm->reg[tm_stack_reg(in)]--;
+  }
+  tm->reg[PC_REG] = undo->pc;
+  if ( (op == opIN) && (undo->where >= 0) ) rev->inNow--;
+  if ( (op == opOUT) && (rev->output == NULL) && (tm->outCount > 0) )
+    tm->outCount--;
+} /* undo */
+
+/********************************************/
+/* replay runs forward to step target, or to
+ * where the pc leaves iMem; with loc >= 0 it
+ * gives the last step before target at which
+ * the pc was loc, or -1
+ */
+static long replay (TMState * tm, long target, int loc)
+{ TMRev * rev = tm->rev;
+  long found = -1;
+  rev->replaying = TRUE;
+  while (rev->steps < target)
+  { if (tm->reg[PC_REG] == loc) found = rev->steps;
+    if (tm_step(tm) == srIMEM_ERR) break;
+  }
+  rev->replaying = FALSE;
+  return found;
+} /* replay */
+
+/********************************************/
+/* restore goes to checkpoint k */
+static int restore (TMState * tm, int k)
+{ TMRev * rev = tm->rev;
+  int inPos = tm->inPos; /* new input only */
+  if (! tm_restore(tm,rev->cp[k].snap)) return FALSE;
+  tm->inPos = inPos;
+  rev->steps = rev->cp[k].steps;
+  rev->inNow = rev->cp[k].inputs;
+  rev->logFirst = rev->steps;
+  return TRUE;
+} /* restore */
+
+/********************************************/
+/* goTo takes the history to step target */
+static int goTo (TMState * tm, long target)
+{ TMRev * rev = tm->rev;
+  int k;
+  if ( (target >= rev->logFirst) && (target <= rev->steps) )
+  { while (rev->steps > target) undo(tm);
+    return TRUE;
+  }
+  if (target < rev->steps)
+  { for (k = rev->ncp - 1; (k > 0) && (rev->cp[k].steps > target); k--)
+      ;
+    if (! restore(tm,k)) return FALSE;
+  }
+  replay(tm,target,-1);
+  return TRUE;
+} /* goTo */
+
+/********************************************/
+long tm_rev_step (TMState * tm, long n)
+{ long from = tm->rev->steps;
+  if (n > from) n = from;
+  goTo(tm,from - n);
+  return from - tm->rev->steps;
+} /* tm_rev_step */
+
+/********************************************/
+int tm_rev_continue (TMState * tm, int loc)
+{ TMRev * rev = tm->rev;
+  long now = rev->steps, end, t;
+  int k;
+  if (loc < 0) return goTo(tm,0);
+  for (t = now - 1; t >= rev->logFirst; t--)
+    if (rev->log[t % UNDO_RECORDS].pc == loc) return goTo(tm,t);
+  /* the stretches between checkpoints before
+   * the log, latest first */
+  end = rev->logFirst;
+  for (k = rev->ncp - 1; k >= 0; k--)
+  { if (rev->cp[k].steps >= end) continue;
+    if (! restore(tm,k)) break;
+    t = replay(tm,end,loc);
+    if (t >= 0) return goTo(tm,t);
+    end = rev->cp[k].steps;
+  }
+  goTo(tm,now);
+  return FALSE;
+} /* tm_rev_continue */
+
+/********************************************/
+int tm_rev_start (TMState * tm)
+{ TMRev * rev;
+  tm_rev_stop(tm);
+  rev = (TMRev *) calloc(1,sizeof(TMRev));
+  if (rev == NULL) return FALSE;
+  rev->log = (UNDOREC *) malloc(UNDO_RECORDS * sizeof(UNDOREC));
+  rev->spacing = CHECKPOINT_STEPS;
+  rev->input = tm->input;
+  rev->output = tm->output;
+  tm->rev = rev;
+  if (rev->log != NULL) checkpoint(tm);
+  if (rev->ncp == 0)
+  { tm_rev_stop(tm);
+    return FALSE;
+  }
+  tm->input = revInput;
+  tm->output = revOutput;
+  return TRUE;
+} /* tm_rev_start */
+
+/********************************************/
+void tm_rev_stop (TMState * tm)
+{ TMRev * rev = tm->rev;
+  int k;
+  if (rev == NULL) return;
+  tm->input = rev->input;
+  tm->output = rev->output;
+  for (k = 0; k < rev->ncp; k++) tm_snapshot_free(rev->cp[k].snap);
+  free(rev->log);
+  free(rev->inputs);
+  free(rev);
+  tm->rev = NULL;
+} /* tm_rev_stop */
@@ -0,0 +1,93 @@
+/****************************************************/
+/* File: tmrev.h                                    */
+/* Reverse execution for the TM library: an undo    */
+/* log of the last steps, and checkpoints           */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMREV_H_
+#define _TMREV_H_
+
+#include "tmvm.h"
+
+/* steps the undo log holds */
+#define UNDO_RECORDS     (1 << 20)
+
+/* checkpoints kept; when there are more, every
+ * other one is dropped and the spacing doubled
+ */
+#define MAX_CHECKPOINTS  64
+#define CHECKPOINT_STEPS (1 << 16) /* first spacing */
+
+/* What one step overwrote: the pc, and register
+ * where (0..6), or dMem[where-NO_REGS], or
+ * nothing else (where < 0). The stack pointer
+ * of PUSH, POP, RET and CALL is not recorded,
+ * as it only moves by one.
+ */
+typedef struct {
+      int pc ;
+      int where ;
+      int old ;
+   } UNDOREC;
+
+typedef struct {
+      long steps ;     /* where in the history */
+      long inputs ;    /* IN values read by then */
+      TMSnapshot * snap ;
+   } CHECKPOINT;
+
+/* The history of a machine since tm_rev_start.
+ * Every value IN reads is kept, so going back
+ * and running forward again reads the same
+ * values, and OUT is not repeated on the
+ * terminal; the history is a single line.
+ */
+typedef struct TMRevRec
+   { long steps ;       /* steps since tm_rev_start */
+     UNDOREC * log ;    /* step s in log[s % UNDO_RECORDS] */
+     long logFirst ;    /* first step still in the log */
+     int * inputs ;     /* values read by IN */
+     long ninputs ;
+     long inCap ;
+     long inNow ;       /* IN values read so far */
+     CHECKPOINT cp [MAX_CHECKPOINTS] ;
+     int ncp ;
+     long spacing ;
+     int replaying ;    /* running again: OUT is quiet */
+     int (* input) (TMState * tm, int * value) ;
+     void (* output) (TMState * tm, int value) ;
+   } TMRev;
+
+/* Function tm_rev_start starts recording the
+ * history of tm from its current state, dropping
+ * any history before. While tm->rev is set tm_run
+ * uses tm_step, and tm->input and tm->output are
+ * those of the history. FALSE if out of memory.
+ */
+int tm_rev_start (TMState * tm);
+
+/* Procedure tm_rev_stop drops the history */
+void tm_rev_stop (TMState * tm);
+
+/* Function tm_rev_record is called by tm_step at
+ * each step; it gives the record to fill in
+ */
+UNDOREC * tm_rev_record (TMState * tm, int pc);
+
+/* Function tm_rev_step goes back n steps, or to
+ * the start of the history; it gives the number
+ * of steps gone back
+ */
+long tm_rev_step (TMState * tm, long n);
+
+/* Function tm_rev_continue goes back to the last
+ * time the pc was loc (before the instruction
+ * there ran), or to the start of the history if
+ * loc is -1. FALSE, leaving tm as it was, if loc
+ * was not reached.
+ */
+int tm_rev_continue (TMState * tm, int loc);
+
+#endif
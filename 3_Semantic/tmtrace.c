@@ -0,0 +1,89 @@
+/****************************************************/
+/* File: tmtrace.c                                  */
+/* Binary execution trace for the TM library        */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include "tmtrace.h"
+
+/********************************************/
+/* flush writes the buffered records */
+static void flush (TMTrace * trace)
+{ if ( (trace->count > 0)
+       && (fwrite(trace->recs,sizeof(TMTRECORD),trace->count,trace->out)
+           != (size_t) trace->count) )
+    trace->failed = TRUE;
+  trace->count = 0;
+} /* flush */
+
+/********************************************/
+int tm_trace_start (TMState * tm, FILE * out)
+{ TMTHEADER hdr;
+  TMTrace * trace = (TMTrace *) malloc(sizeof(TMTrace));
+  if (trace == NULL) return FALSE;
+  hdr.magic = TMT_MAGIC;
+  hdr.recSize = sizeof(TMTRECORD);
+  if (fwrite(&hdr,sizeof(hdr),1,out) != 1)
+  { free(trace);
+    return FALSE;
+  }
+  trace->out = out;
+  trace->count = 0;
+  trace->failed = FALSE;
+  tm_trace_stop(tm);
+  tm->trace = trace;
+  return TRUE;
+} /* tm_trace_start */
+
+/********************************************/
+TMTRECORD * tm_trace_next (TMState * tm)
+{ TMTrace * trace = tm->trace;
+  if (trace->count == TRACE_RECORDS) flush(trace);
+  return &trace->recs[trace->count++];
+} /* tm_trace_next */
+
+/********************************************/
+int tm_trace_stop (TMState * tm)
+{ TMTrace * trace = tm->trace;
+  int ok;
+  if (trace == NULL) return TRUE;
+  flush(trace);
+  ok = ! trace->failed;
+  free(trace);
+  tm->trace = NULL;
+  return ok;
+} /* tm_trace_stop */
+
+/********************************************/
+int tm_trace_decode (FILE * in, FILE * out, int values)
+{ TMTHEADER hdr;
+  TMTRECORD recs[TRACE_RECORDS];
+  INSTRUCTION instr;
+  int n, k;
+  if ( (fread(&hdr,sizeof(hdr),1,in) != 1) || (hdr.magic != TMT_MAGIC)
+       || (hdr.recSize != sizeof(TMTRECORD)) )
+    return FALSE;
+  while ( (n = fread(recs,sizeof(TMTRECORD),TRACE_RECORDS,in)) > 0 )
+    for (k = 0; k < n; k++)
+    { instr.iop = TMB_OP(recs[k].code);
+      if (instr.iop > opRALim) return FALSE;
+      instr.iarg1 = TMB_R(recs[k].code);
+      if (opClass(instr.iop) == opclRR)
+      { instr.iarg2 = TMB_S(recs[k].code);
+        instr.iarg3 = TMB_T(recs[k].code);
+      }
+      else
+      { instr.iarg2 = recs[k].disp;
+        instr.iarg3 = TMB_S(recs[k].code);
+      }
+      tm_print_instruction(out,recs[k].pc,&instr);
+      if (values)
+      { fprintf(out,"\t%d",recs[k].value);
+        if (recs[k].addr >= 0) fprintf(out,"\t@%d",recs[k].addr);
+      }
+      fputc('\n',out);
+    }
+  return TRUE;
+} /* tm_trace_decode */
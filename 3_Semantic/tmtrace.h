@@ -0,0 +1,76 @@
+/****************************************************/
+/* File: tmtrace.h                                  */
+/* Binary execution trace for the TM library:       */
+/* fixed-size records buffered in memory            */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMTRACE_H_
+#define _TMTRACE_H_
+
+#include "tmvm.h"
+
+/* records buffered before a write */
+#define TRACE_RECORDS 4096
+
+/* A trace file is a TMTHEADER followed by one
+ * TMTRECORD for each instruction executed, in
+ * host byte order. The instruction is stored as
+ * in a .tmb file, so the trace can be read
+ * without the program. value is reg(r) after the
+ * instruction (what IN read, OUT wrote or ST
+ * stored, the result of the others; the new pc
+ * if r is the pc), or 0 if it faulted; addr is
+ * the dMem address of LD and ST, -1 otherwise.
+ */
+#define TMT_MAGIC  0x31544D54   /* "TMT1" read as an int */
+
+typedef struct {
+      int magic ;
+      int recSize ; /* sizeof(TMTRECORD) */
+   } TMTHEADER;
+
+typedef struct {
+      int pc ;
+      int code ;  /* op, r, s and t packed by TMB_CODE */
+      int disp ;
+      int value ;
+      int addr ;
+   } TMTRECORD;
+
+/* The records not yet written */
+typedef struct TMTraceRec
+   { FILE * out ;
+     int count ;
+     int failed ; /* a write went wrong */
+     TMTRECORD recs [TRACE_RECORDS] ;
+   } TMTrace;
+
+/* Function tm_trace_start writes a trace header
+ * to out and starts tracing: while tm->trace is
+ * set tm_run executes with tm_step, which fills a
+ * record for each instruction. out is left open
+ * by tm_trace_stop. Returns FALSE on failure.
+ */
+int tm_trace_start (TMState * tm, FILE * out);
+
+/* Function tm_trace_next gives the record for the
+ * next instruction, writing the buffer when full
+ */
+TMTRECORD * tm_trace_next (TMState * tm);
+
+/* Function tm_trace_stop writes the records left
+ * and stops tracing; FALSE if a write failed
+ */
+int tm_trace_stop (TMState * tm);
+
+/* Function tm_trace_decode renders the trace file
+ * in as text, one tm_write_instruction line per
+ * record, adding the value and address when
+ * values is set. Returns FALSE if in is not a
+ * trace file.
+ */
+int tm_trace_decode (FILE * in, FILE * out, int values);
+
+#endif
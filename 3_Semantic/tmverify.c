@@ -0,0 +1,440 @@
+/****************************************************/
+/* File: tmverify.c                                 */
+/* Load-time verifier for the TM library            */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "tmverify.h"
+
+/* The analysis follows every path from tm_reset
+ * with a range for each register and for dMem[0]
+ * (where cgen keeps the size of memory), merging
+ * at each location until nothing changes. An
+ * access that faults ends its path, so after it
+ * the base register is known to address dMem.
+ *
+ * A jump to a location not known in advance,
+ * such as a return through LD pc or RET, is not
+ * followed: it gets VERIFY_CHECK, and the engines
+ * check the state it lands in with
+ * tm_verify_entry. Instead, a return address
+ * (LDA r,d(pc), or the one CALL pushes) gives its
+ * location the state of the call, with only the
+ * registers cgen's calls keep: the stack pointer,
+ * which the callee gives back as it was, and the
+ * global pointer. So frame accesses from mp are
+ * verified across calls and returns.
+ */
+typedef struct {
+      TMState * tm ;
+      TMVerify * v ;
+      int * work ;    /* locations to look at again */
+      int nwork ;
+      char * queued ;
+      char * target ; /* reached by a jump or return */
+      VSTATE * next ; /* narrowing: the states again */
+   } ANALYSIS;
+
+/* the registers a cgen call keeps: mp, and gp */
+#define   KEEP_MP  6
+#define   KEEP_GP  5
+
+/********************************************/
+/* range gives lo..hi, or every int if that does
+ * not fit: the machine wraps around
+ */
+static VRANGE range (long long lo, long long hi)
+{ VRANGE r;
+  if ( (lo < INT_MIN) || (hi > INT_MAX) )
+  { r.lo = INT_MIN;
+    r.hi = INT_MAX;
+  }
+  else
+  { r.lo = (int) lo;
+    r.hi = (int) hi;
+  }
+  return r;
+} /* range */
+
+/********************************************/
+/* value gives the range of register r at loc */
+static VRANGE value (VSTATE * st, int r, int loc)
+{ if (r == PC_REG) return range(loc + 1,loc + 1);
+  return st->reg[r];
+} /* value */
+
+/********************************************/
+/* corners gives the range of the four values */
+static VRANGE corners (long long a, long long b, long long c, long long d)
+{ long long lo = a, hi = a;
+  if (b < lo) lo = b;
+  if (b > hi) hi = b;
+  if (c < lo) lo = c;
+  if (c > hi) hi = c;
+  if (d < lo) lo = d;
+  if (d > hi) hi = d;
+  return range(lo,hi);
+} /* corners */
+
+/********************************************/
+/* joinRange widens *a to take in b; widen sends
+ * a bound that moves straight to its limit
+ */
+static int joinRange (VRANGE * a, VRANGE b, int widen)
+{ int changed = FALSE;
+  if (b.lo < a->lo)
+  { a->lo = widen ? INT_MIN : b.lo;
+    changed = TRUE;
+  }
+  if (b.hi > a->hi)
+  { a->hi = widen ? INT_MAX : b.hi;
+    changed = TRUE;
+  }
+  return changed;
+} /* joinRange */
+
+/********************************************/
+/* merge adds st to *in; TRUE if *in changed.
+ * Only jump targets (target) are widened: every
+ * loop goes through one, and elsewhere the ranges
+ * an access narrowed are kept
+ */
+static int merge (VSTATE * in, VSTATE * st, int target)
+{ int k, widen, changed = FALSE;
+  if (! in->reached)
+  { *in = *st;
+    in->reached = TRUE;
+    in->changes = 0;
+    return TRUE;
+  }
+  widen = target && (in->changes >= VERIFY_WIDEN);
+  for (k = 0; k < PC_REG; k++)
+    changed |= joinRange(&in->reg[k],st->reg[k],widen);
+  changed |= joinRange(&in->mem0,st->mem0,widen);
+  if (changed) in->changes++;
+  return changed;
+} /* merge */
+
+/********************************************/
+/* flowTo merges st into the state at loc; past
+ * the program there are only HALTs or a fault
+ */
+static void flowTo (ANALYSIS * a, VSTATE * st, int loc)
+{ if ( (loc < 0) || (loc >= a->v->size) ) return;
+  if (a->next != NULL)
+  { merge(&a->next[loc],st,FALSE);
+    return;
+  }
+  if ( merge(&a->v->in[loc],st,a->target[loc]) && ! a->queued[loc] )
+  { a->queued[loc] = TRUE;
+    a->work[a->nwork++] = loc;
+  }
+} /* flowTo */
+
+/********************************************/
+/* jumpTo follows the jump at loc to a location
+ * in t; one not known in advance is checked
+ * where it lands
+ */
+static void jumpTo (ANALYSIS * a, VSTATE * st, VRANGE t, int loc)
+{ if (t.lo != t.hi) a->v->flags[loc] |= VERIFY_CHECK;
+  else if ( (t.lo >= 0) && (t.lo < a->v->size) )
+  { a->target[t.lo] = TRUE;
+    flowTo(a,st,t.lo);
+  }
+} /* jumpTo */
+
+/********************************************/
+/* returnTo gives return address ret the state
+ * st of its call, keeping only the registers
+ * the callee gives back (and sp, the stack
+ * register of a CALL)
+ */
+static void returnTo (ANALYSIS * a, VSTATE * st, int ret, int sp)
+{ VSTATE in = *st;
+  int k;
+  for (k = 0; k < PC_REG; k++)
+    if ( (k != KEEP_MP) && (k != KEEP_GP) && (k != sp) )
+      in.reg[k] = range(INT_MIN,INT_MAX);
+  in.mem0 = range(INT_MIN,INT_MAX);
+  if ( (ret < 0) || (ret >= a->v->size) ) return;
+  a->target[ret] = TRUE;
+  flowTo(a,&in,ret);
+} /* returnTo */
+
+/********************************************/
+/* inMemory narrows register s to the values for
+ * which d+reg[s] is in dMem, after an access
+ * there: the paths on which it faults end
+ */
+static void inMemory (VSTATE * st, int s, int d, int dSize)
+{ VRANGE * x;
+  if (s == PC_REG) return;
+  x = &st->reg[s];
+  /* d+reg[s] might wrap around into dMem */
+  if ( ((long long) d + x->lo < INT_MIN) || ((long long) d + x->hi > INT_MAX) )
+    return;
+  if ( (long long) x->lo < - (long long) d ) x->lo = - d;
+  if ( (long long) x->hi > (long long) dSize - 1 - d ) x->hi = dSize - 1 - d;
+} /* inMemory */
+
+/********************************************/
+/* address gives the range of d+reg(s) of the
+ * RM instruction at loc
+ */
+static VRANGE address (VSTATE * st, INSTRUCTION * in, int loc)
+{ VRANGE s = value(st,in->iarg3,loc);
+  return range((long long) in->iarg2 + s.lo,(long long) in->iarg2 + s.hi);
+} /* address */
+
+/********************************************/
+/* transfer follows the instruction at loc from
+ * the state there, like tm_step; paths that
+ * always fault end
+ */
+static void transfer (ANALYSIS * a, int loc)
+{ VSTATE st = a->v->in[loc];
+  INSTRUCTION * in = &a->tm->pgm->iMem[loc];
+  int r = in->iarg1, dSize = a->v->dSize, sp;
+  VRANGE x, y, res;
+  if (opClass(in->iop) == opclRR)
+  { x = value(&st,in->iarg2,loc);
+    y = value(&st,in->iarg3,loc);
+  }
+  else
+  { x = value(&st,in->iarg3,loc);
+    y = x;
+  }
+  switch (in->iop)
+  { case opHALT :
+      return;
+    case opIN :
+      res = range(INT_MIN,INT_MAX);
+      break;
+    case opADD :
+      res = range((long long) x.lo + y.lo,(long long) x.hi + y.hi);
+      break;
+    case opSUB :
+      res = range((long long) x.lo - y.hi,(long long) x.hi - y.lo);
+      break;
+    case opMUL :
+      res = corners((long long) x.lo * y.lo,(long long) x.lo * y.hi,
+                    (long long) x.hi * y.lo,(long long) x.hi * y.hi);
+      break;
+    case opDIV :
+      if ( (y.lo == 0) && (y.hi == 0) ) return;
+      if ( (y.lo <= 0) && (y.hi >= 0) ) res = range(INT_MIN,INT_MAX);
+      else res = corners((long long) x.lo / y.lo,(long long) x.lo / y.hi,
+                         (long long) x.hi / y.lo,(long long) x.hi / y.hi);
+      break;
+    case opLD :
+      x = address(&st,in,loc);
+      if ( (x.hi < 0) || (x.lo >= dSize) ) return;
+      inMemory(&st,in->iarg3,in->iarg2,dSize);
+      if ( (x.lo == 0) && (x.hi == 0) ) res = st.mem0;
+      else res = range(INT_MIN,INT_MAX);
+      break;
+    case opST :
+      x = address(&st,in,loc);
+      if ( (x.hi < 0) || (x.lo >= dSize) ) return;
+      y = value(&st,r,loc);
+      inMemory(&st,in->iarg3,in->iarg2,dSize);
+      if ( (x.lo == 0) && (x.hi == 0) ) st.mem0 = y;
+      else if ( (x.lo <= 0) && (x.hi >= 0) ) joinRange(&st.mem0,y,FALSE);
+      flowTo(a,&st,loc + 1);
+      return;
+    case opPUSH :
+    case opCALL :
+      sp = tm_stack_reg(in);
+      y = value(&st,sp,loc);
+      if ( (y.hi < 0) || (y.lo >= dSize) ) return;
+      inMemory(&st,sp,0,dSize);
+      if (in->iop == opCALL) returnTo(a,&st,loc + 1,sp);
+      y = value(&st,sp,loc);
+      res = (in->iop == opPUSH) ? value(&st,r,loc) : range(loc + 1,loc + 1);
+      if ( (y.lo == 0) && (y.hi == 0) ) st.mem0 = res;
+      else if ( (y.lo <= 0) && (y.hi >= 0) ) joinRange(&st.mem0,res,FALSE);
+      st.reg[sp] = range((long long) y.lo - 1,(long long) y.hi - 1);
+      if (in->iop == opPUSH) flowTo(a,&st,loc + 1);
+      else jumpTo(a,&st,range((long long) in->iarg2 + x.lo,
+                              (long long) in->iarg2 + x.hi),loc);
+      return;
+    case opPOP :
+    case opRET :
+      x = range((long long) x.lo + 1,(long long) x.hi + 1);
+      if ( (x.hi < 0) || (x.lo >= dSize) ) return;
+      inMemory(&st,in->iarg2,1,dSize);
+      x = value(&st,in->iarg2,loc);
+      x = range((long long) x.lo + 1,(long long) x.hi + 1);
+      if ( (x.lo == 0) && (x.hi == 0) ) res = st.mem0;
+      else res = range(INT_MIN,INT_MAX);
+      st.reg[in->iarg2] = x;
+      if (in->iop == opRET)
+      { jumpTo(a,&st,res,loc);
+        return;
+      }
+      break;
+    case opMCPY :
+    case opMSET :
+    case opVADD :
+    case opVMUL :
+      /* only a block from 0 on takes in dMem[0] */
+      res = value(&st,r,loc);
+      if ( (res.lo <= 0) && (res.hi >= 0) )
+        joinRange(&st.mem0,in->iop == opMSET ? x : range(INT_MIN,INT_MAX),
+                  FALSE);
+      flowTo(a,&st,loc + 1);
+      return;
+    case opVSUM :
+      res = range(INT_MIN,INT_MAX);
+      break;
+    case opVMIN :
+    case opVMAX :
+      if (y.hi < 0) return;
+      res = range(-1,(long long) y.hi - 1);
+      break;
+    case opLDA :
+      if ( (in->iarg3 == PC_REG) && (r != PC_REG) )
+        returnTo(a,&st,loc + 1 + in->iarg2,-1);
+      res = range((long long) in->iarg2 + x.lo,(long long) in->iarg2 + x.hi);
+      break;
+    case opLDC :
+      res = range(in->iarg2,in->iarg2);
+      break;
+    case opJLT :
+    case opJLE :
+    case opJGT :
+    case opJGE :
+    case opJEQ :
+    case opJNE :
+      flowTo(a,&st,loc + 1);
+      jumpTo(a,&st,range((long long) in->iarg2 + x.lo,
+                         (long long) in->iarg2 + x.hi),loc);
+      return;
+    default : /* OUT, and the class limits */
+      flowTo(a,&st,loc + 1);
+      return;
+  }
+  if (r == PC_REG) jumpTo(a,&st,res,loc);
+  else
+  { st.reg[r] = res;
+    flowTo(a,&st,loc + 1);
+  }
+} /* transfer */
+
+/********************************************/
+/* setFlags marks what cannot fault at loc */
+static void setFlags (TMState * tm, TMVerify * v, int loc)
+{ VSTATE * st = &v->in[loc];
+  INSTRUCTION * in = &tm->pgm->iMem[loc];
+  VRANGE t;
+  if (! st->reached) return;
+  if ( (in->iop == opLD) || (in->iop == opST) )
+  { t = address(st,in,loc);
+    if ( (t.lo >= 0) && (t.hi < v->dSize) ) v->flags[loc] |= VERIFY_MEM;
+  }
+  if ( ((in->iop >= opJLT) && (in->iop <= opJNE))
+       || ((in->iarg1 == PC_REG) && (in->iop == opLDA)) )
+  { t = value(st,in->iarg3,loc);
+    t = range((long long) in->iarg2 + t.lo,(long long) in->iarg2 + t.hi);
+    if ( (t.lo >= 0) && (t.hi < tm->pgm->iMemSize) )
+      v->flags[loc] |= VERIFY_JUMP;
+  }
+} /* setFlags */
+
+/********************************************/
+int tm_verify (TMState * tm)
+{ TMProgram * pgm = tm->pgm;
+  ANALYSIS a;
+  TMVerify * v;
+  VSTATE start;
+  int size = pgm->iSize, loc, k;
+  tm_verify_free(pgm->verify);
+  pgm->verify = NULL;
+  if ( (size <= 0) || (size > VERIFY_MAX) ) return FALSE;
+  v = (TMVerify *) malloc(sizeof(TMVerify));
+  if (v == NULL) return FALSE;
+  v->dSize = tm->dSize;
+  v->size = size;
+  v->flags = (unsigned char *) calloc(size,1);
+  v->in = (VSTATE *) calloc(size,sizeof(VSTATE));
+  a.tm = tm;
+  a.v = v;
+  a.next = NULL;
+  a.work = (int *) malloc(size * sizeof(int));
+  a.nwork = 0;
+  a.queued = (char *) calloc(size,1);
+  a.target = (char *) calloc(size,1);
+  if ( (v->flags == NULL) || (v->in == NULL) || (a.work == NULL)
+       || (a.queued == NULL) || (a.target == NULL) )
+  { tm_verify_free(v);
+    free(a.work);
+    free(a.queued);
+    free(a.target);
+    return FALSE;
+  }
+  /* the state tm_reset leaves */
+  for (k = 0; k < PC_REG; k++) start.reg[k] = range(0,0);
+  start.mem0 = range(tm->dSize - 1,tm->dSize - 1);
+  start.reached = FALSE;
+  flowTo(&a,&start,0);
+  while (a.nwork > 0)
+  { loc = a.work[--a.nwork];
+    a.queued[loc] = FALSE;
+    transfer(&a,loc);
+  }
+  /* narrowing: following every location once
+   * more from these states gives states that
+   * still hold, without what widening added */
+  for (k = 0; k < VERIFY_NARROW; k++)
+  { a.next = (VSTATE *) calloc(size,sizeof(VSTATE));
+    if (a.next == NULL) break;
+    flowTo(&a,&start,0);
+    for (loc = 0; loc < size; loc++)
+      if (v->in[loc].reached) transfer(&a,loc);
+    free(v->in);
+    v->in = a.next;
+    a.next = NULL;
+  }
+  for (loc = 0; loc < size; loc++) setFlags(tm,v,loc);
+  free(a.work);
+  free(a.queued);
+  free(a.target);
+  pgm->verify = v;
+  return TRUE;
+} /* tm_verify */
+
+/********************************************/
+int tm_verify_flags (TMState * tm, int loc)
+{ TMVerify * v = tm->pgm->verify;
+  if ( (v == NULL) || (loc < 0) || (loc >= v->size) ) return 0;
+  return v->flags[loc];
+} /* tm_verify_flags */
+
+/********************************************/
+int tm_verify_entry (TMState * tm)
+{ TMVerify * v = tm->pgm->verify;
+  VSTATE * st;
+  int pc = tm->reg[PC_REG], k, in;
+  if (v == NULL) return TRUE;
+  if (v->dSize != tm->dSize) return FALSE;
+  /* past the program: HALT, or a fault at once */
+  if ( (pc < 0) || (pc >= v->size) ) return TRUE;
+  st = &v->in[pc];
+  in = st->reached && VERIFY_IN(tm->dMem[0],st->mem0);
+  for (k = 0; k < PC_REG; k++)
+    in &= VERIFY_IN(tm->reg[k],st->reg[k]);
+  return in;
+} /* tm_verify_entry */
+
+/********************************************/
+void tm_verify_free (TMVerify * v)
+{ if (v == NULL) return;
+  free(v->flags);
+  free(v->in);
+  free(v);
+} /* tm_verify_free */
@@ -0,0 +1,96 @@
+/****************************************************/
+/* File: tmverify.h                                 */
+/* Load-time verifier for the TM library: finds the */
+/* LD, ST and jumps that cannot fault               */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMVERIFY_H_
+#define _TMVERIFY_H_
+
+#include "tmvm.h"
+
+/* flags of a location */
+#define VERIFY_MEM   1 /* LD/ST address always in dMem */
+#define VERIFY_JUMP  2 /* jump target always in iMem */
+#define VERIFY_CHECK 4 /* a jump the analysis did not
+                        * follow: tm_verify_entry must
+                        * hold where it lands */
+
+/* larger programs are not verified */
+#define VERIFY_MAX   (1 << 16)
+
+/* changes to the state at a jump target before
+ * its ranges are widened, so that loops terminate
+ */
+#define VERIFY_WIDEN 4
+
+/* passes over the program after that, each
+ * narrowing the ranges widening gave
+ */
+#define VERIFY_NARROW 2
+
+/* the values a register may hold */
+typedef struct {
+      int lo, hi ;
+   } VRANGE;
+
+/* VERIFY_IN(x,r) tells whether x is in r: x-lo
+ * is at most hi-lo, unsigned, with no branch
+ */
+#define VERIFY_IN(x,r) ((unsigned) (x) - (unsigned) (r).lo \
+                        <= (unsigned) (r).hi - (unsigned) (r).lo)
+
+/* what holds each time a location is reached
+ * from tm_reset, other than by a jump flagged
+ * VERIFY_CHECK: register ranges, and the range
+ * of dMem[0], which holds dSize-1 at first
+ */
+typedef struct {
+      VRANGE reg [PC_REG] ;
+      VRANGE mem0 ;
+      int reached ;
+      int changes ;
+   } VSTATE;
+
+/* The result, for data memory of dSize, and the
+ * size locations of the program (the HALTs past
+ * it have no flags)
+ */
+typedef struct TMVerifyRec
+   { int dSize ;
+     int size ;
+     unsigned char * flags ;
+     VSTATE * in ;
+   } TMVerify;
+
+/* Function tm_verify replaces tm->pgm->verify by
+ * an interval analysis of the program for data
+ * memory of tm->dSize. It leaves it NULL (and
+ * returns FALSE) for programs over VERIFY_MAX,
+ * or when out of memory: then every access is
+ * checked.
+ */
+int tm_verify (TMState * tm);
+
+/* Function tm_verify_flags gives the flags of
+ * location loc of the program of tm
+ */
+int tm_verify_flags (TMState * tm, int loc);
+
+/* Function tm_verify_entry tells whether the
+ * engines may rely on the flags when running
+ * from the current state of tm: the state must
+ * be one the analysis allowed for at the pc,
+ * and the data memory the size verified for.
+ * tm_run falls back to tm_step otherwise, at
+ * the start of a run and after each jump
+ * flagged VERIFY_CHECK.
+ */
+int tm_verify_entry (TMState * tm);
+
+/* Procedure tm_verify_free frees a result */
+void tm_verify_free (TMVerify * v);
+
+#endif
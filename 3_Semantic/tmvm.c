@@ -0,0 +1,1785 @@
+/****************************************************/
+/* File: tmvm.c                                     */
+/* The TM ("Tiny Machine") virtual machine library  */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tmvm.h"
+#include "tmjit.h"
+#include "tmprof.h"
+#include "tmtrace.h"
+#include "tmrev.h"
+#include "tmbreak.h"
+#include "tmverify.h"
+
+char * opCodeTab[] = TM_OPCODE_NAMES;
+
+char * engineTab[]
+        = {"switch","threaded","jit"
+          };
+
+char * stepResultTab[]
+        = {"OK","Halted","Instruction Memory Fault",
+           "Data Memory Fault","Division by 0",
+           "Input Exhausted","Breakpoint","Watchpoint",
+           "Limit Exceeded"
+          };
+
+#if HAVE_THREADED
+static STEPRESULT runThreaded (TMState * tm, int * icount);
+#endif
+
+/********************************************/
+int opClass( int c )
+{ if      ( c <= opRRLim) return ( opclRR );
+  else if ( c <= opRMLim) return ( opclRM );
+  else                    return ( opclRA );
+} /* opClass */
+
+/********************************************/
+int tm_stack_reg (INSTRUCTION * in)
+{ switch ( in->iop )
+  { case opPUSH :
+    case opPOP :
+    case opRET :  return in->iarg2 ;
+    case opCALL : return in->iarg1 ;
+    default :     return -1 ;
+  }
+} /* tm_stack_reg */
+
+/********************************************/
+void tm_print_instruction ( FILE * out, int loc, INSTRUCTION * in )
+{ fprintf(out, "%5d: ", loc) ;
+  fprintf(out,"%6s%3d,", opCodeTab[in->iop], in->iarg1);
+  switch ( opClass(in->iop) )
+  { case opclRR: fprintf(out,"%1d,%1d", in->iarg2, in->iarg3);
+                 break;
+    case opclRM:
+    case opclRA: fprintf(out,"%3d(%1d)", in->iarg2, in->iarg3);
+                 break;
+  }
+} /* tm_print_instruction */
+
+/********************************************/
+void tm_write_instruction ( TMState * tm, FILE * out, int loc )
+{ if ( (loc >= 0) && (loc < tm->pgm->iMemSize) )
+  { tm_print_instruction(out,loc,&tm->pgm->iMem[loc]) ;
+    fprintf (out,"\n") ;
+  }
+  else fprintf(out, "%5d: ", loc) ;
+} /* tm_write_instruction */
+
+/********************************************/
+void tm_set_line (TMLine * l, char * text)
+{ strncpy(l->text,text,LINESIZE-1) ;
+  l->text[LINESIZE-1] = '\0' ;
+  l->len = strlen(l->text) ;
+  if ( (l->len > 0) && (l->text[l->len-1] == '\n') )
+    l->text[--l->len] = '\0' ;
+  l->col = 0 ;
+} /* tm_set_line */
+
+/********************************************/
+static void getCh (TMLine * l)
+{ if (++l->col < l->len)
+  l->ch = l->text[l->col] ;
+  else l->ch = ' ' ;
+} /* getCh */
+
+/********************************************/
+static int nonBlank (TMLine * l)
+{ while ((l->col < l->len)
+         && (l->text[l->col] == ' ') )
+    l->col++ ;
+  if (l->col < l->len)
+  { l->ch = l->text[l->col] ;
+    return TRUE ; }
+  else
+  { l->ch = ' ' ;
+    return FALSE ; }
+} /* nonBlank */
+
+/********************************************/
+int tm_get_num (TMLine * l)
+{ int sign;
+  int term;
+  int temp = FALSE;
+  l->num = 0 ;
+  do
+  { sign = 1;
+    while ( nonBlank(l) && ((l->ch == '+') || (l->ch == '-')) )
+    { temp = FALSE ;
+      if (l->ch == '-')  sign = - sign ;
+      getCh(l);
+    }
+    term = 0 ;
+    nonBlank(l);
+    while (isdigit(l->ch))
+    { temp = TRUE ;
+      term = term * 10 + ( l->ch - '0' ) ;
+      getCh(l);
+    }
+    l->num = l->num + (term * sign) ;
+  } while ( (nonBlank(l)) && ((l->ch == '+') || (l->ch == '-')) ) ;
+  return temp;
+} /* tm_get_num */
+
+/********************************************/
+int tm_get_word (TMLine * l)
+{ int temp = FALSE;
+  int length = 0;
+  if (nonBlank (l))
+  { while (isalnum(l->ch))
+    { if (length < WORDSIZE-1) l->word [length++] =  l->ch ;
+      getCh(l) ;
+    }
+    l->word[length] = '\0';
+    temp = (length != 0);
+  }
+  return temp;
+} /* tm_get_word */
+
+/********************************************/
+int tm_skip_ch ( TMLine * l, char c  )
+{ int temp = FALSE;
+  if ( nonBlank(l) && (l->ch == c) )
+  { getCh(l);
+    temp = TRUE;
+  }
+  return temp;
+} /* tm_skip_ch */
+
+/********************************************/
+int tm_at_eol(TMLine * l)
+{ return ( ! nonBlank (l));
+} /* tm_at_eol */
+
+/********************************************/
+static int error( char * msg, int lineNo, int instNo)
+{ fprintf(stderr,"Line %d",lineNo);
+  if (instNo >= 0) fprintf(stderr," (Instruction %d)",instNo);
+  fprintf(stderr,"   %s\n",msg);
+  return FALSE;
+} /* error */
+
+/******* const *******/
+/* data memory up to this many bytes is cleared
+ * by writing it; larger ones give back their
+ * pages to the system, which reads them as 0 */
+#define   CLEAR_BYTES  65536
+
+/********************************************/
+/* mapData gives tm a data memory of size words.
+ * The mapping reserves no memory: pages are
+ * committed when they are first written.
+ */
+static int mapData (TMState * tm, int size)
+{ void * map;
+  if ( (size <= 0) || ((size_t) size > SIZE_MAX / sizeof(int)) )
+    return FALSE;
+  map = mmap(NULL,size * sizeof(int),PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,-1,0);
+  if (map == MAP_FAILED) return FALSE;
+  if (tm->dMem != NULL) munmap(tm->dMem,tm->dSize * sizeof(int));
+  tm->dMem = (int *) map;
+  tm->dSize = size;
+  return TRUE;
+} /* mapData */
+
+/********************************************/
+TMState * tm_create (void)
+{ TMState * tm = (TMState *) calloc(1,sizeof(TMState));
+  if (tm == NULL) return NULL;
+  if (! mapData(tm,DADDR_SIZE))
+  { free(tm);
+    return NULL;
+  }
+  tm->iLimit = IADDR_SIZE;
+  tm->engine = HAVE_THREADED ? engTHREADED : engSWITCH;
+  tm->nextCheck = INT_MAX;
+  return tm;
+} /* tm_create */
+
+/********************************************/
+int tm_set_memory (TMState * tm, int iLimit, int dSize)
+{ if ( (iLimit <= 0) || (iLimit > MAX_IADDR_SIZE) ) return FALSE;
+  if (dSize != tm->dSize)
+  { if (! mapData(tm,dSize)) return FALSE;
+    tm_watch_free(tm); /* sized for the old memory */
+  }
+  tm->iLimit = iLimit;
+  /* compiled code has the sizes built in */
+  tm_jit_free(tm);
+  /* so has the verified program, unless shared */
+  if ( (tm->pgm != NULL) && (tm->pgm->refs == 1)
+       && (tm->pgm->verify != NULL) && (tm->pgm->verify->dSize != dSize) )
+  { tm_verify(tm);
+    tm_decode(tm);
+  }
+  tm_reset(tm);
+  return TRUE;
+} /* tm_set_memory */
+
+/********************************************/
+TMState * tm_share (TMState * tm)
+{ TMState * copy = tm_create();
+  if (copy == NULL) return NULL;
+  if ( (tm->dSize != copy->dSize) && ! mapData(copy,tm->dSize) )
+  { tm_destroy(copy);
+    return NULL;
+  }
+  copy->iLimit = tm->iLimit;
+  copy->pgm = tm->pgm;
+  copy->pgm->refs++;
+  copy->engine = tm->engine;
+  copy->jitCheck = tm->jitCheck;
+  copy->maxSteps = tm->maxSteps;
+  copy->maxSeconds = tm->maxSeconds;
+  tm_reset(copy);
+  return copy;
+} /* tm_share */
+
+/********************************************/
+static void releaseProgram (TMProgram * pgm)
+{ if ( (pgm != NULL) && (--pgm->refs == 0) )
+  { free(pgm->iMem);
+    free(pgm->tMem);
+    tm_verify_free(pgm->verify);
+    tm_break_free(pgm->brk);
+    free(pgm);
+  }
+} /* releaseProgram */
+
+/********************************************/
+void tm_destroy (TMState * tm)
+{ if (tm == NULL) return;
+  tm_jit_free(tm);
+  tm_profile_stop(tm);
+  tm_trace_stop(tm);
+  tm_rev_stop(tm);
+  tm_watch_free(tm);
+  releaseProgram(tm->pgm);
+  munmap(tm->dMem,tm->dSize * sizeof(int));
+  free(tm->outVals);
+  free(tm);
+} /* tm_destroy */
+
+/********************************************/
+/* clearData zeroes dMem: large memories are
+ * handed back to the system page by page
+ */
+static void clearData (TMState * tm)
+{ size_t bytes = tm->dSize * sizeof(int);
+  if ( (bytes <= CLEAR_BYTES)
+       || (madvise(tm->dMem,bytes,MADV_DONTNEED) != 0) )
+    memset(tm->dMem,0,bytes);
+} /* clearData */
+
+/********************************************/
+void tm_reset (TMState * tm)
+{ int regNo;
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+      tm->reg[regNo] = 0 ;
+  clearData(tm);
+  tm->dMem[0] = tm->dSize - 1 ;
+  tm->iloc = 0 ;
+  tm->fused = 0 ;
+  tm->inPos = 0 ;
+  tm->outCount = 0 ;
+} /* tm_reset */
+
+/********************************************/
+TMSnapshot * tm_snapshot (TMState * tm)
+{ size_t page = sysconf(_SC_PAGESIZE);
+  size_t bytes = tm->dSize * sizeof(int);
+  size_t n = (bytes + page - 1) / page, k;
+  unsigned char * vec = (unsigned char *) malloc(n);
+  TMSnapshot * snap = (TMSnapshot *) calloc(1,sizeof(TMSnapshot));
+  if ( (vec == NULL) || (snap == NULL) )
+  { free(vec);
+    free(snap);
+    return NULL;
+  }
+  /* the pages in use are the ones in memory */
+  if (mincore(tm->dMem,bytes,vec) != 0) memset(vec,1,n);
+  for (k = 0; k < n; k++)
+    if (vec[k] & 1) snap->npages++;
+  snap->pageNo = (size_t *) malloc((snap->npages + 1) * sizeof(size_t));
+  snap->pages = (char *) malloc(snap->npages * page + 1);
+  snap->outVals = (int *) malloc((tm->outCount + 1) * sizeof(int));
+  if ( (snap->pageNo == NULL) || (snap->pages == NULL)
+       || (snap->outVals == NULL) )
+  { free(vec);
+    snap->pgm = NULL;
+    tm_snapshot_free(snap);
+    return NULL;
+  }
+  snap->npages = 0;
+  for (k = 0; k < n; k++)
+    if (vec[k] & 1)
+    { snap->pageNo[snap->npages] = k;
+      memcpy(snap->pages + snap->npages++ * page,(char *) tm->dMem + k * page,
+             (k + 1) * page > bytes ? bytes - k * page : page);
+    }
+  free(vec);
+  memcpy(snap->reg,tm->reg,sizeof(snap->reg));
+  snap->dSize = tm->dSize;
+  snap->iloc = tm->iloc;
+  snap->inPos = tm->inPos;
+  snap->outCount = tm->outCount;
+  if (tm->outCount > 0)
+    memcpy(snap->outVals,tm->outVals,tm->outCount * sizeof(int));
+  snap->pgm = tm->pgm;
+  snap->pgm->refs++;
+  return snap;
+} /* tm_snapshot */
+
+/********************************************/
+int tm_restore (TMState * tm, TMSnapshot * snap)
+{ size_t page = sysconf(_SC_PAGESIZE);
+  size_t bytes = snap->dSize * sizeof(int);
+  int k;
+  if (tm->outCap < snap->outCount)
+  { int * vals = (int *) realloc(tm->outVals,snap->outCount * sizeof(int));
+    if (vals == NULL) return FALSE;
+    tm->outVals = vals;
+    tm->outCap = snap->outCount;
+  }
+  if (snap->dSize != tm->dSize)
+  { if (! mapData(tm,snap->dSize)) return FALSE;
+    tm_jit_free(tm);
+    tm_watch_free(tm);
+  }
+  else clearData(tm);
+  if (tm->pgm != snap->pgm)
+  { tm_jit_free(tm);
+    tm_watch_free(tm);
+    snap->pgm->refs++;
+    releaseProgram(tm->pgm);
+    tm->pgm = snap->pgm;
+    if ( (tm->prof != NULL) && ! tm_profile_start(tm) ) return FALSE;
+  }
+  for (k = 0; k < snap->npages; k++)
+    memcpy((char *) tm->dMem + snap->pageNo[k] * page,snap->pages + k * page,
+           (snap->pageNo[k] + 1) * page > bytes ? bytes - snap->pageNo[k] * page
+                                                : page);
+  memcpy(tm->reg,snap->reg,sizeof(tm->reg));
+  tm->iloc = snap->iloc;
+  tm->fused = 0;
+  tm->inPos = snap->inPos;
+  tm->outCount = snap->outCount;
+  if (snap->outCount > 0)
+    memcpy(tm->outVals,snap->outVals,snap->outCount * sizeof(int));
+  return TRUE;
+} /* tm_restore */
+
+/********************************************/
+void tm_snapshot_free (TMSnapshot * snap)
+{ if (snap == NULL) return;
+  releaseProgram(snap->pgm);
+  free(snap->pageNo);
+  free(snap->pages);
+  free(snap->outVals);
+  free(snap);
+} /* tm_snapshot_free */
+
+/********************************************/
+void tm_set_input (TMState * tm, int * vals, int n)
+{ tm->inVals = vals ;
+  tm->inCount = n ;
+  tm->inPos = 0 ;
+} /* tm_set_input */
+
+/********************************************/
+/* growIMem enlarges iMem to size locations,
+ * the new ones holding HALT
+ */
+static int growIMem (TMProgram * pgm, int size)
+{ INSTRUCTION * iMem ;
+  int loc ;
+  if (size <= pgm->iMemSize) return TRUE ;
+  iMem = (INSTRUCTION *) realloc(pgm->iMem,size * sizeof(INSTRUCTION)) ;
+  if (iMem == NULL) return FALSE ;
+  for (loc = pgm->iMemSize ; loc < size ; loc++)
+  { iMem[loc].iop = opHALT ;
+    iMem[loc].iarg1 = 0 ;
+    iMem[loc].iarg2 = 0 ;
+    iMem[loc].iarg3 = 0 ;
+  }
+  pgm->iMem = iMem ;
+  pgm->iMemSize = size ;
+  return TRUE ;
+} /* growIMem */
+
+/********************************************/
+static int readInstructions (TMProgram * pgm, FILE * in)
+{ INSTRUCTION * iMem ;
+  TMLine line ;
+  char buf[LINESIZE] ;
+  OPCODE op;
+  int arg1, arg2, arg3;
+  int loc, lineNo;
+  lineNo = 0 ;
+  while (fgets( buf, LINESIZE-2, in ) != NULL)
+  { tm_set_line(&line,buf) ;
+    lineNo++;
+    if ( (nonBlank(&line)) && (line.text[line.col] != '*') )
+    { if (! tm_get_num(&line))
+        return error("Bad location", lineNo,-1);
+      loc = line.num;
+      if ((loc < 0) || (loc >= MAX_IADDR_SIZE))
+        return error("Location too large",lineNo,loc);
+      if ( (loc >= pgm->iMemSize)
+           && ! growIMem(pgm,loc < pgm->iMemSize * 2 ? pgm->iMemSize * 2
+                                                     : loc + 1) )
+        return error("Out of memory",lineNo,loc);
+      if (! tm_skip_ch(&line,':'))
+        return error("Missing colon", lineNo,loc);
+      if (! tm_get_word (&line))
+        return error("Missing opcode", lineNo,loc);
+      op = opHALT ;
+      while ((op < opRALim)
+             && (strncmp(opCodeTab[op], line.word, 4) != 0) )
+          op++ ;
+      if (strncmp(opCodeTab[op], line.word, 4) != 0)
+          return error("Illegal opcode", lineNo,loc);
+      switch ( opClass(op) )
+      { case opclRR :
+        /***********************************/
+        if ( (! tm_get_num (&line)) || (line.num < 0) || (line.num >= NO_REGS) )
+            return error("Bad first register", lineNo,loc);
+        arg1 = line.num;
+        if ( ! tm_skip_ch(&line,','))
+            return error("Missing comma", lineNo, loc);
+        if ( (! tm_get_num (&line)) || (line.num < 0) || (line.num >= NO_REGS) )
+            return error("Bad second register", lineNo, loc);
+        arg2 = line.num;
+        if ( ! tm_skip_ch(&line,','))
+            return error("Missing comma", lineNo,loc);
+        if ( (! tm_get_num (&line)) || (line.num < 0) || (line.num >= NO_REGS) )
+            return error("Bad third register", lineNo,loc);
+        arg3 = line.num;
+        break;
+
+        case opclRM :
+        case opclRA :
+        /***********************************/
+        if ( (! tm_get_num (&line)) || (line.num < 0) || (line.num >= NO_REGS) )
+            return error("Bad first register", lineNo,loc);
+        arg1 = line.num;
+        if ( ! tm_skip_ch(&line,','))
+            return error("Missing comma", lineNo,loc);
+        if (! tm_get_num (&line))
+            return error("Bad displacement", lineNo,loc);
+        arg2 = line.num;
+        if ( ! tm_skip_ch(&line,'(') && ! tm_skip_ch(&line,',') )
+            return error("Missing LParen", lineNo,loc);
+        if ( (! tm_get_num (&line)) || (line.num < 0) || (line.num >= NO_REGS))
+            return error("Bad second register", lineNo,loc);
+        arg3 = line.num;
+        break;
+        }
+      iMem = pgm->iMem;
+      iMem[loc].iop = op;
+      iMem[loc].iarg1 = arg1;
+      iMem[loc].iarg2 = arg2;
+      iMem[loc].iarg3 = arg3;
+      if (tm_stack_reg(&iMem[loc]) == PC_REG)
+        return error("Bad stack register", lineNo,loc);
+      if (loc >= pgm->iSize) pgm->iSize = loc + 1;
+    }
+  }
+  return TRUE;
+} /* readInstructions */
+
+/********************************************/
+/* readObject loads a binary (.tmb) program by
+ * mapping the file and unpacking it straight
+ * into iMem; only the fields are range checked
+ */
+static int readObject (TMProgram * pgm, FILE * in, char * name)
+{ INSTRUCTION * iMem ;
+  struct stat st;
+  void * map;
+  TMBHEADER * hdr;
+  TMBINSTR * obj;
+  int loc, op, r, s, t;
+  if ( (fstat(fileno(in),&st) != 0)
+       || (st.st_size < (off_t) sizeof(TMBHEADER)) )
+  { fprintf(stderr,"%s: not a TM object file\n",name);
+    return FALSE;
+  }
+  map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fileno(in),0);
+  if (map == MAP_FAILED)
+  { fprintf(stderr,"%s: cannot map file\n",name);
+    return FALSE;
+  }
+  hdr = (TMBHEADER *) map;
+  obj = (TMBINSTR *) (hdr + 1);
+  if ( (hdr->magic != TMB_MAGIC) || (hdr->size < 0)
+       || (hdr->size > MAX_IADDR_SIZE)
+       || (st.st_size != (off_t) (sizeof(TMBHEADER)
+                           + hdr->size * sizeof(TMBINSTR))) )
+  { fprintf(stderr,"%s: bad TM object header\n",name);
+    munmap(map,st.st_size);
+    return FALSE;
+  }
+  if (! growIMem(pgm,hdr->size))
+  { fprintf(stderr,"%s: out of memory\n",name);
+    munmap(map,st.st_size);
+    return FALSE;
+  }
+  iMem = pgm->iMem;
+  for (loc = 0 ; loc < hdr->size ; loc++)
+  { op = TMB_OP(obj[loc].code);
+    r = TMB_R(obj[loc].code);
+    s = TMB_S(obj[loc].code);
+    t = TMB_T(obj[loc].code);
+    if ( (op >= opRALim) || (op == opRRLim) || (op == opRMLim)
+         || (r >= NO_REGS) || (s >= NO_REGS) || (t >= NO_REGS) )
+    { fprintf(stderr,"%s: bad instruction at location %d\n",name,loc);
+      munmap(map,st.st_size);
+      return FALSE;
+    }
+    iMem[loc].iop = op;
+    iMem[loc].iarg1 = r;
+    if (opClass(op) == opclRR)
+    { iMem[loc].iarg2 = s;
+      iMem[loc].iarg3 = t;
+    }
+    else
+    { iMem[loc].iarg2 = obj[loc].disp;
+      iMem[loc].iarg3 = s;
+    }
+    if (tm_stack_reg(&iMem[loc]) == PC_REG)
+    { fprintf(stderr,"%s: bad instruction at location %d\n",name,loc);
+      munmap(map,st.st_size);
+      return FALSE;
+    }
+  }
+  pgm->iSize = hdr->size;
+  munmap(map,st.st_size);
+  return TRUE;
+} /* readObject */
+
+/********************************************/
+int tm_is_object (char * name)
+{ int len = strlen(name);
+  return (len > 4) && (strcmp(name + len - 4,".tmb") == 0);
+} /* tm_is_object */
+
+/********************************************/
+int tm_load (TMState * tm, char * name)
+{ TMProgram * pgm;
+  FILE * in;
+  int ok;
+  in = fopen(name,"r");
+  if (in == NULL)
+  { fprintf(stderr,"file '%s' not found\n",name);
+    return FALSE;
+  }
+  pgm = (TMProgram *) calloc(1,sizeof(TMProgram));
+  if ( (pgm == NULL) || ! growIMem(pgm,tm->iLimit) )
+  { fprintf(stderr,"out of memory loading '%s'\n",name);
+    free(pgm);
+    fclose(in);
+    return FALSE;
+  }
+  pgm->refs = 1 ;
+  if (tm_is_object(name)) ok = readObject(pgm,in,name);
+  else ok = readInstructions(pgm,in);
+  fclose(in);
+  /* the text loader grows iMem in steps: the
+   * size is the larger of iLimit and the program */
+  if (pgm->iMemSize > tm->iLimit)
+    pgm->iMemSize = (pgm->iSize > tm->iLimit) ? pgm->iSize : tm->iLimit;
+  /* room for the predecoded program */
+  if ( ok && ((pgm->tMem = (THREADEDINSTR *) malloc((pgm->iMemSize + 1)
+                            * sizeof(THREADEDINSTR))) == NULL) )
+  { fprintf(stderr,"out of memory loading '%s'\n",name);
+    ok = FALSE;
+  }
+  if (! ok)
+  { releaseProgram(pgm);
+    return FALSE;
+  }
+  tm_jit_free(tm);
+  releaseProgram(tm->pgm);
+  tm->pgm = pgm;
+  if ( (tm->prof != NULL) && ! tm_profile_start(tm) )
+    fprintf(stderr,"out of memory for the profile of '%s'\n",name);
+  /* without a result every access is checked */
+  tm_verify(tm);
+  /* predecode now, so the program stays read-only */
+  tm_decode(tm);
+  tm_reset(tm);
+  return TRUE;
+} /* tm_load */
+
+/********************************************/
+void tm_decode (TMState * tm)
+{
+#if HAVE_THREADED
+  runThreaded(tm,NULL);
+#endif
+} /* tm_decode */
+
+/********************************************/
+/* tm_write_object writes iMem[0..iSize-1] to out
+ * in the binary object format of tm.h
+ */
+int tm_write_object (TMState * tm, FILE * out)
+{ TMBHEADER hdr;
+  TMBINSTR obj;
+  INSTRUCTION * in;
+  int loc;
+  hdr.magic = TMB_MAGIC;
+  hdr.size = tm->pgm->iSize;
+  fwrite(&hdr,sizeof(hdr),1,out);
+  for (loc = 0 ; loc < tm->pgm->iSize ; loc++)
+  { in = &tm->pgm->iMem[loc];
+    if (opClass(in->iop) == opclRR)
+    { obj.code = TMB_CODE(in->iop,in->iarg1,in->iarg2,in->iarg3);
+      obj.disp = 0;
+    }
+    else
+    { obj.code = TMB_CODE(in->iop,in->iarg1,in->iarg3,0);
+      obj.disp = in->iarg2;
+    }
+    fwrite(&obj,sizeof(obj),1,out);
+  }
+  return ! ferror(out);
+} /* tm_write_object */
+
+/********************************************/
+/* tm_write_text writes iMem[0..iSize-1] to out
+ * in the text format emitted by code.c
+ */
+int tm_write_text (TMState * tm, FILE * out)
+{ INSTRUCTION * in;
+  int loc;
+  for (loc = 0 ; loc < tm->pgm->iSize ; loc++)
+  { in = &tm->pgm->iMem[loc];
+    if (opClass(in->iop) == opclRR)
+      fprintf(out,"%3d:  %5s  %d,%d,%d \n",loc,
+              opCodeTab[in->iop],in->iarg1,in->iarg2,in->iarg3);
+    else
+      fprintf(out,"%3d:  %5s  %d,%d(%d) \n",loc,
+              opCodeTab[in->iop],in->iarg1,in->iarg2,in->iarg3);
+  }
+  return ! ferror(out);
+} /* tm_write_text */
+
+/********************************************/
+static void putValue (TMState * tm, int v)
+{ if (tm->output != NULL)
+  { tm->output(tm,v);
+    return;
+  }
+  if (tm->outCount == tm->outCap)
+  { int cap = tm->outCap ? 2 * tm->outCap : 256;
+    int * vals = (int *) realloc(tm->outVals,cap * sizeof(int));
+    if (vals == NULL) return; /* value lost, but keep running */
+    tm->outVals = vals;
+    tm->outCap = cap;
+  }
+  tm->outVals[tm->outCount++] = v;
+} /* putValue */
+
+/********************************************/
+/* inBlock tells whether the n words from a on
+ * are all in a memory of size words
+ */
+static int inBlock (int a, int n, int size)
+{ return (n >= 0) && (a >= 0) && (a <= size - n) ;
+} /* inBlock */
+
+/********************************************/
+/* watchBlock looks for a watched word among the
+ * n from m on, which are about to be written
+ */
+static int watchBlock (TMState * tm, int m, int n)
+{ for ( ; n > 0 ; m++, n--)
+    if ( WATCHED(tm->watch->bits,m) )
+    { tm->watch->addr = m ;
+      tm->watch->old = tm->dMem[m] ;
+      return TRUE ;
+    }
+  return FALSE ;
+} /* watchBlock */
+
+/********************************************/
+/* The vector instructions work on VECWORDS
+ * words at a time in the SIMD registers of the
+ * host, with GNU C vector types; arithmetic is
+ * unsigned so that it wraps like the other
+ * compilers' scalar code
+ */
+#ifdef __GNUC__
+#define VECWORDS 4
+typedef unsigned UVECTOR __attribute__ ((vector_size (VECWORDS * 4))) ;
+typedef int VECTOR __attribute__ ((vector_size (VECWORDS * 4))) ;
+#else
+#define VECWORDS 1
+#endif
+
+/* VECOP makes procedure name, which does
+ * a[k] = a[k] OP b[k] for k < n, reading each
+ * word of b before writing over it: backwards
+ * when a is above b in the same block
+ */
+#ifdef __GNUC__
+#define VECOP(name,OP) \
+static void name (int * a, int * b, int n) \
+{ UVECTOR x, y ; \
+  int k ; \
+  if ( (a <= b) || (a >= b + n) ) \
+  { for (k = 0 ; k + VECWORDS <= n ; k += VECWORDS) \
+    { memcpy(&x,a + k,sizeof x) ; \
+      memcpy(&y,b + k,sizeof y) ; \
+      x = x OP y ; \
+      memcpy(a + k,&x,sizeof x) ; \
+    } \
+    for ( ; k < n ; k++) a[k] = (unsigned) a[k] OP (unsigned) b[k] ; \
+  } \
+  else \
+  { for (k = n ; k >= VECWORDS ; ) \
+    { k -= VECWORDS ; \
+      memcpy(&x,a + k,sizeof x) ; \
+      memcpy(&y,b + k,sizeof y) ; \
+      x = x OP y ; \
+      memcpy(a + k,&x,sizeof x) ; \
+    } \
+    while (k-- > 0) a[k] = (unsigned) a[k] OP (unsigned) b[k] ; \
+  } \
+}
+#else
+#define VECOP(name,OP) \
+static void name (int * a, int * b, int n) \
+{ int k ; \
+  if ( (a <= b) || (a >= b + n) ) \
+    for (k = 0 ; k < n ; k++) a[k] = (unsigned) a[k] OP (unsigned) b[k] ; \
+  else \
+    for (k = n - 1 ; k >= 0 ; k--) a[k] = (unsigned) a[k] OP (unsigned) b[k] ; \
+}
+#endif
+
+VECOP(vecAdd,+)
+VECOP(vecMul,*)
+
+/********************************************/
+/* vecSum gives the sum of the n words from a */
+static int vecSum (int * a, int n)
+{ unsigned sum = 0 ;
+  int k = 0 ;
+#ifdef __GNUC__
+  UVECTOR x, acc = { 0 } ;
+  int j ;
+  for ( ; k + VECWORDS <= n ; k += VECWORDS)
+  { memcpy(&x,a + k,sizeof x) ;
+    acc += x ;
+  }
+  for (j = 0 ; j < VECWORDS ; j++) sum += acc[j] ;
+#endif
+  for ( ; k < n ; k++) sum += a[k] ;
+  return (int) sum ;
+} /* vecSum */
+
+/********************************************/
+/* vecBest gives the index of the last of the n
+ * words from a that is a new least (greatest,
+ * with max) as they are gone through from x on,
+ * or -1 if none is: a word w is the new x when
+ * w - x, wrapped around, is below (above) 0, as
+ * SUB then JLT (JGT) tests. That is no order, so
+ * the lanes only go when every word and x lie
+ * within 2^31 of each other, where it is one
+ */
+static int vecBest (int * a, int n, int x, int max)
+{ int k, best = -1 ;
+#ifdef __GNUC__
+  if ( n >= 2 * VECWORDS )
+  { VECTOR w, lo, hi, mask ;
+    int j, l = x, h = x ;
+    memcpy(&lo,a,sizeof lo) ;
+    hi = lo ;
+    for (k = VECWORDS ; k + VECWORDS <= n ; k += VECWORDS)
+    { memcpy(&w,a + k,sizeof w) ;
+      mask = w < lo ;
+      lo = (w & mask) | (lo & ~mask) ;
+      mask = w > hi ;
+      hi = (w & mask) | (hi & ~mask) ;
+    }
+    for (j = 0 ; j < VECWORDS ; j++)
+    { if ( lo[j] < l ) l = lo[j] ;
+      if ( hi[j] > h ) h = hi[j] ;
+    }
+    for ( ; k < n ; k++)
+    { if ( a[k] < l ) l = a[k] ;
+      if ( a[k] > h ) h = a[k] ;
+    }
+    if ( (long long) h - l <= INT_MAX )
+    { j = max ? h : l ;
+      if ( j == x ) return -1 ;
+      for (k = 0 ; a[k] != j ; k++)
+        ;
+      return k ;
+    }
+  }
+#endif
+  for (k = 0 ; k < n ; k++)
+    if ( max ? (int) ((unsigned) a[k] - (unsigned) x) > 0
+             : (int) ((unsigned) a[k] - (unsigned) x) < 0 )
+    { x = a[k] ;
+      best = k ;
+    }
+  return best ;
+} /* vecBest */
+
+/********************************************/
+/* divide gives x / y, for y not 0. The least
+ * int divided by -1 wraps around to itself, as
+ * in the jit and tm2c code, rather than
+ * trapping in the host
+ */
+static int divide (int x, int y)
+{ if ( y == -1 ) return (int) (0u - (unsigned) x) ;
+  return x / y ;
+} /* divide */
+
+/********************************************/
+STEPRESULT tm_step (TMState * tm)
+{ INSTRUCTION currentinstruction  ;
+  TMTRECORD * rec = NULL ;
+  UNDOREC * undo = NULL ;
+  STEPRESULT result = srOKAY ;
+  int * reg = tm->reg ;
+  int * dMem = tm->dMem ;
+  int pc  ;
+  int r,s,t,m,top,stack  ;
+
+  pc = reg[PC_REG] ;
+  tm->iloc = pc ;
+  if ( (pc < 0) || (pc >= tm->pgm->iMemSize)  )
+      return srIMEM_ERR ;
+  if ( tm->rev != NULL ) undo = tm_rev_record (tm, pc) ;
+  reg[PC_REG] = pc + 1 ;
+  if ( tm->prof != NULL ) tm->prof->count[pc]++ ;
+  currentinstruction = tm->pgm->iMem[ pc ] ;
+  if ( tm->trace != NULL )
+  { rec = tm_trace_next (tm) ;
+    rec->pc = pc ;
+    /* packed as in a .tmb file */
+    if ( opClass(currentinstruction.iop) == opclRR )
+    { rec->code = TMB_CODE(currentinstruction.iop, currentinstruction.iarg1,
+                           currentinstruction.iarg2, currentinstruction.iarg3) ;
+      rec->disp = 0 ;
+    }
+    else
+    { rec->code = TMB_CODE(currentinstruction.iop, currentinstruction.iarg1,
+                           currentinstruction.iarg3, 0) ;
+      rec->disp = currentinstruction.iarg2 ;
+    }
+    rec->value = 0 ;
+    rec->addr = -1 ;
+  }
+  switch (opClass(currentinstruction.iop) )
+  { case opclRR :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg2 ;
+      t = currentinstruction.iarg3 ;
+      m = 0 ;
+      break;
+
+    case opclRM :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg3 ;
+      t = 0 ;
+      m = currentinstruction.iarg2 + reg[s] ;
+      if ( rec != NULL ) rec->addr = m ;
+      if ( (m < 0) || (m >= tm->dSize))
+         return srDMEM_ERR ;
+      break;
+
+    case opclRA :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg3 ;
+      t = 0 ;
+      m = (unsigned) currentinstruction.iarg2 + (unsigned) reg[s] ;
+      break;
+  } /* case */
+
+  /* the stack instructions use the word at top */
+  stack = TRUE ;
+  switch ( currentinstruction.iop )
+  { case opPUSH :  top = reg[s] ;  break;
+    case opCALL :  top = reg[r] ;  break;
+    case opPOP :
+    case opRET :   top = reg[s] + 1 ;  break;
+    default :      top = 0 ;  stack = FALSE ;  break;
+  }
+  if ( stack )
+  { if ( rec != NULL ) rec->addr = top ;
+    if ( (top < 0) || (top >= tm->dSize) )
+       return srDMEM_ERR ;
+  }
+
+  /* what the instruction overwrites, for going
+   * back; tmrev.c moves the stack pointer back */
+  if ( undo != NULL )
+  { if ( currentinstruction.iop == opST )
+    { undo->where = NO_REGS + m ;
+      undo->old = dMem[m] ;
+    }
+    else if ( (currentinstruction.iop == opPUSH)
+              || (currentinstruction.iop == opCALL) )
+    { undo->where = NO_REGS + top ;
+      undo->old = dMem[top] ;
+    }
+    else if ( (currentinstruction.iop == opRET)
+              || ((currentinstruction.iop == opPOP) && (r == PC_REG)) )
+    { undo->where = PC_REG ; /* to tell it ran */
+      undo->old = pc ;
+    }
+    else if ( (currentinstruction.iop != opHALT) && (currentinstruction.iop != opOUT)
+              && (currentinstruction.iop != opMCPY)
+              && (currentinstruction.iop != opMSET)
+              && (currentinstruction.iop != opVADD)
+              && (currentinstruction.iop != opVMUL)
+              && (currentinstruction.iop < opJLT) && (r != PC_REG) )
+    { undo->where = r ;
+      undo->old = reg[r] ;
+    }
+  }
+
+  switch ( currentinstruction.iop)
+  { /* RR instructions */
+    case opHALT :
+    /***********************************/
+      return srHALT ;
+      /* break; */
+
+    case opIN :
+    /***********************************/
+      if ( tm->input != NULL )
+      { if ( ! tm->input(tm,&reg[r]) ) return srNO_INPUT ;
+      }
+      else if ( tm->inPos < tm->inCount )
+        reg[r] = tm->inVals[tm->inPos++] ;
+      else return srNO_INPUT ;
+      break;
+
+    case opOUT :  putValue( tm, reg[r] ) ;  break;
+    /* int arithmetic wraps around, as in the jit
+     * and tm2c code, not undefined on overflow */
+    case opADD :  reg[r] = (unsigned) reg[s] + (unsigned) reg[t] ;  break;
+    case opSUB :  reg[r] = (unsigned) reg[s] - (unsigned) reg[t] ;  break;
+    case opMUL :  reg[r] = (unsigned) reg[s] * (unsigned) reg[t] ;  break;
+
+    case opDIV :
+    /***********************************/
+      if ( reg[t] != 0 ) reg[r] = divide(reg[s],reg[t]);
+      else return srZERODIVIDE ;
+      break;
+
+    case opPUSH :
+    /***********************************/
+      if ( (tm->watch != NULL) && WATCHED(tm->watch->bits,top) )
+      { tm->watch->addr = top ;
+        tm->watch->old = dMem[top] ;
+        result = srWATCH ;
+      }
+      dMem[top] = reg[r] ;
+      reg[s] = top - 1 ;
+      break;
+
+    case opPOP :   reg[s] = top ;  reg[r] = dMem[top] ;  break;
+    case opRET :   reg[s] = top ;  reg[PC_REG] = dMem[top] ;  break;
+
+    case opMCPY :
+    case opMSET :
+    case opVADD :
+    case opVMUL :
+    /***********************************/
+      if ( rec != NULL ) rec->addr = reg[r] ;
+      if ( ! inBlock(reg[r],reg[t],tm->dSize)
+           || ( (currentinstruction.iop != opMSET)
+                && ! inBlock(reg[s],reg[t],tm->dSize) ) )
+        return srDMEM_ERR ;
+      if ( (tm->watch != NULL) && watchBlock(tm,reg[r],reg[t]) )
+        result = srWATCH ;
+      if ( currentinstruction.iop == opMCPY )
+        memmove(dMem + reg[r],dMem + reg[s],reg[t] * sizeof(int)) ;
+      else if ( currentinstruction.iop == opMSET )
+        for (m = 0 ; m < reg[t] ; m++) dMem[reg[r] + m] = reg[s] ;
+      else if ( currentinstruction.iop == opVADD )
+        vecAdd(dMem + reg[r],dMem + reg[s],reg[t]) ;
+      else
+        vecMul(dMem + reg[r],dMem + reg[s],reg[t]) ;
+      /* too much for the undo log: going back over
+       * it runs forward from a checkpoint */
+      if ( undo != NULL ) tm->rev->logFirst = tm->rev->steps ;
+      break;
+
+    case opVSUM :
+    case opVMIN :
+    case opVMAX :
+    /***********************************/
+      if ( rec != NULL ) rec->addr = reg[s] ;
+      if ( ! inBlock(reg[s],reg[t],tm->dSize) ) return srDMEM_ERR ;
+      if ( currentinstruction.iop == opVSUM )
+        reg[r] = vecSum(dMem + reg[s],reg[t]) ;
+      else
+        reg[r] = vecBest(dMem + reg[s],reg[t],reg[r],
+                         currentinstruction.iop == opVMAX) ;
+      break;
+
+    /*************** RM instructions ********************/
+    case opLD :    reg[r] = dMem[m] ;  break;
+    case opST :
+    /***********************************/
+      if ( (tm->watch != NULL) && WATCHED(tm->watch->bits,m) )
+      { tm->watch->addr = m ;
+        tm->watch->old = dMem[m] ;
+        dMem[m] = reg[r] ;
+        if ( rec != NULL ) rec->value = reg[r] ;
+        return srWATCH ;
+      }
+      dMem[m] = reg[r] ;
+      break;
+
+    /*************** RA instructions ********************/
+    case opLDA :    reg[r] = m ; break;
+    case opLDC :    reg[r] = currentinstruction.iarg2 ;   break;
+    case opCALL :
+    /***********************************/
+      if ( (tm->watch != NULL) && WATCHED(tm->watch->bits,top) )
+      { tm->watch->addr = top ;
+        tm->watch->old = dMem[top] ;
+        result = srWATCH ;
+      }
+      dMem[top] = reg[PC_REG] ;
+      reg[r] = top - 1 ;
+      reg[PC_REG] = m ;
+      break;
+    case opJLT :    if ( reg[r] <  0 ) reg[PC_REG] = m ; break;
+    case opJLE :    if ( reg[r] <=  0 ) reg[PC_REG] = m ; break;
+    case opJGT :    if ( reg[r] >  0 ) reg[PC_REG] = m ; break;
+    case opJGE :    if ( reg[r] >=  0 ) reg[PC_REG] = m ; break;
+    case opJEQ :    if ( reg[r] == 0 ) reg[PC_REG] = m ; break;
+    case opJNE :    if ( reg[r] != 0 ) reg[PC_REG] = m ; break;
+
+    /* end of legal instructions */
+  } /* case */
+  if ( (tm->prof != NULL) && (reg[PC_REG] != pc + 1) )
+    tm->prof->taken[pc]++ ;
+  if ( rec != NULL ) rec->value = reg[r] ;
+  return result ;
+} /* tm_step */
+
+#if HAVE_THREADED
+/********************************************/
+/* runThreaded executes from reg[PC_REG] until
+ * an instruction returns something other than
+ * srOKAY, exactly as repeated calls of tm_step
+ * would. Common instructions get a handler of
+ * their own, while HALT, IN, OUT and any
+ * instruction that writes the pc other than
+ * through LDA are handed back to tm_step.
+ * *icount receives the number of steps,
+ * including the last one, and tm->iloc the
+ * location of the last one. With icount NULL,
+ * iMem is only predecoded into tMem (tm_load).
+ *
+ * With FUSE_THREADED, predecoding also gives
+ * the first location of some sequences cgen
+ * emits a superinstruction handler, which does
+ * the whole sequence with a single dispatch:
+ * - the test of an if or while
+ *     SUB r,s,t / Jxx r,d(pc)
+ *   subtracts and branches;
+ * - a comparison used as a value, as the
+ *   peephole pass leaves it
+ *     SUB s,r,s / LDC r,1 / Jxx s,1(pc) / LDC r,0
+ *   or as cgen writes it without that pass
+ *     SUB r,s,t / Jxx r,2(pc) / LDC r,0 /
+ *     LDA pc,1(pc) / LDC r,1
+ *   becomes one test setting r to 0 or 1;
+ * - pairs of straight-line instructions such
+ *   as the push ST / LD and the pop LD / ADD
+ *   run back to back, with a direct jump from
+ *   the first to the second.
+ * The other locations keep their own handlers,
+ * so jumping into a sequence still works, and
+ * the counts, registers and faults are those of
+ * the instructions one at a time. tm->fused
+ * receives the number of dispatches saved.
+ *
+ * LD, ST and jumps the verifier proved cannot
+ * fault get handlers (named ..._u) without the
+ * address check; tm_run makes sure the run
+ * starts from a state the proof covers. After
+ * a jump the verifier did not follow (a return,
+ * mostly) the same test is made where it lands,
+ * and if it fails runThreaded returns srOKAY:
+ * tm_run carries on with tm_step.
+ *
+ * A breakpoint replaces the handler of its
+ * location by a trap, and no superinstruction
+ * runs through it. A machine with watchpoints
+ * runs a copy of tMem of its own, in which each
+ * ST checks them, and PUSH, CALL and the other
+ * stores to blocks go to tm_step.
+ */
+static STEPRESULT runThreaded (TMState * tm, int * icount)
+{ THREADEDINSTR * tMem = tm->pgm->tMem ;
+  int * reg = tm->reg ;
+  int * dMem = tm->dMem ;
+  int dSize = tm->dSize ;
+  int iMemSize = tm->pgm->iMemSize ;
+  THREADEDINSTR * ip ;
+  STEPRESULT result ;
+  int pc, m, v, loc ;
+  int count = 0 ;
+  int fused = 0 ;
+  int next = tm->nextCheck ; /* of count, for tm_limit */
+  TMVerify * verify = tm->pgm->verify ;
+  VSTATE * st ;
+
+#define DISPATCH() { ip = &tMem[pc] ; reg[PC_REG] = pc + 1 ; \
+                     count++ ; goto *ip->handler ; }
+#define NEXT()     { pc++ ; DISPATCH() ; }
+#define JUMP(a)    { pc = (a) ; \
+                     if ( (pc < 0) || (pc >= iMemSize) ) \
+                     { count++ ; goto imem_err ; } \
+                     if ( count >= next ) goto limit ; \
+                     DISPATCH() ; }
+#define JUMPU(a)   { pc = (a) ; \
+                     if ( count >= next ) goto limit ; \
+                     DISPATCH() ; }
+/* second half of a pair: the next location,
+ * without going through its handler pointer */
+#define INTO(l)    { pc++ ; ip++ ; reg[PC_REG] = pc + 1 ; \
+                     count++ ; fused++ ; goto l ; }
+
+#define OP_ADD  reg[ip->r] = (unsigned) reg[ip->s] + (unsigned) reg[ip->t] ;
+#define OP_SUB  reg[ip->r] = (unsigned) reg[ip->s] - (unsigned) reg[ip->t] ;
+#define OP_MUL  reg[ip->r] = (unsigned) reg[ip->s] * (unsigned) reg[ip->t] ;
+#define OP_LD   m = ip->d + reg[ip->s] ; \
+                if ( (m < 0) || (m >= dSize) ) goto dmem_err ; \
+                reg[ip->r] = dMem[m] ;
+#define OP_ST   m = ip->d + reg[ip->s] ; \
+                if ( (m < 0) || (m >= dSize) ) goto dmem_err ; \
+                dMem[m] = reg[ip->r] ;
+#define OP_LDU  reg[ip->r] = dMem[ip->d + reg[ip->s]] ;
+#define OP_STU  dMem[ip->d + reg[ip->s]] = reg[ip->r] ;
+#define OP_LDA  reg[ip->r] = (unsigned) ip->d + (unsigned) reg[ip->s] ;
+#define OP_LDC  reg[ip->r] = ip->d ;
+
+/* the true case of a comparison runs SUB, Jxx
+ * and LDC; the false case SUB, Jxx, LDC and LDA.
+ * The difference wraps around, as the SUB does */
+#define COMPARE(test) { v = (unsigned) reg[ip->s] - (unsigned) reg[ip->t] ; \
+                        if ( v test 0 ) \
+                        { reg[ip->r] = 1 ; count += 2 ; fused += 2 ; } \
+                        else \
+                        { reg[ip->r] = 0 ; count += 3 ; fused += 3 ; } \
+                        pc += 5 ; DISPATCH() ; }
+/* the peephole form: SUB s,r,s leaves the
+ * difference in s (ip->r) and the value goes to
+ * r (ip->s). The true case runs SUB, LDC and
+ * Jxx; the false case the LDC r,0 as well */
+#define VALUE(test)   { v = (unsigned) reg[ip->s] - (unsigned) reg[ip->t] ; \
+                        reg[ip->r] = v ; \
+                        if ( v test 0 ) \
+                        { reg[ip->s] = 1 ; count += 2 ; fused += 2 ; } \
+                        else \
+                        { reg[ip->s] = 0 ; count += 3 ; fused += 3 ; } \
+                        pc += 4 ; DISPATCH() ; }
+
+  if ( icount == NULL )
+  { TMProgram * pgm = tm->pgm ;
+    INSTRUCTION * in ;
+    /* pairs: handlers of the two locations, and
+     * the superinstruction replacing the first */
+    static void * const pairTab[][3] =
+      { { &&do_st,  &&do_ld,  &&do_st_ld  },
+        { &&do_st,  &&do_ldc, &&do_st_ldc },
+        { &&do_st,  &&do_lda, &&do_st_lda },
+        { &&do_ld,  &&do_st,  &&do_ld_st  },
+        { &&do_ld,  &&do_ld,  &&do_ld_ld  },
+        { &&do_ld,  &&do_add, &&do_ld_add },
+        { &&do_ld,  &&do_sub, &&do_ld_sub },
+        { &&do_ld,  &&do_mul, &&do_ld_mul },
+        { &&do_ld,  &&do_div, &&do_ld_div },
+        { &&do_ldc, &&do_ld,  &&do_ldc_ld },
+        { &&do_ldc, &&do_st,  &&do_ldc_st },
+        { &&do_lda, &&do_st,  &&do_lda_st },
+        { &&do_add, &&do_st,  &&do_add_st },
+        { &&do_sub, &&do_st,  &&do_sub_st },
+        { &&do_mul, &&do_st,  &&do_mul_st },
+        { &&do_div, &&do_st,  &&do_div_st }
+      } ;
+    /* the same pairs with LD and ST unchecked */
+    static void * const pairTabU[] =
+      { &&do_st_ld_u,  &&do_st_ldc_u, &&do_st_lda_u, &&do_ld_st_u,
+        &&do_ld_ld_u,  &&do_ld_add_u, &&do_ld_sub_u, &&do_ld_mul_u,
+        &&do_ld_div_u, &&do_ldc_ld_u, &&do_ldc_st_u, &&do_lda_st_u,
+        &&do_add_st_u, &&do_sub_st_u, &&do_mul_st_u, &&do_div_st_u
+      } ;
+    /* conditional jumps, indexed by Jxx - opJLT */
+    static void * const jumpTab[] =
+      { &&do_jlt, &&do_jle, &&do_jgt,
+        &&do_jge, &&do_jeq, &&do_jne } ;
+    static void * const jumpTabU[] =
+      { &&do_jlt_u, &&do_jle_u, &&do_jgt_u,
+        &&do_jge_u, &&do_jeq_u, &&do_jne_u } ;
+    /* comparisons, indexed by Jxx - opJLT */
+    static void * const compareTab[] =
+      { &&do_cmp_lt, &&do_cmp_le, &&do_cmp_gt,
+        &&do_cmp_ge, &&do_cmp_eq, &&do_cmp_ne } ;
+    static void * const valueTab[] =
+      { &&do_val_lt, &&do_val_le, &&do_val_gt,
+        &&do_val_ge, &&do_val_eq, &&do_val_ne } ;
+    /* SUB and a branch, indexed by Jxx - opJLT,
+     * then with the jump unchecked */
+    static void * const branchTab[][6] =
+      { { &&do_sub_jlt, &&do_sub_jle, &&do_sub_jgt,
+          &&do_sub_jge, &&do_sub_jeq, &&do_sub_jne },
+        { &&do_sub_jlt_u, &&do_sub_jle_u, &&do_sub_jgt_u,
+          &&do_sub_jge_u, &&do_sub_jeq_u, &&do_sub_jne_u } } ;
+    void * h0, * h1 ;
+    unsigned p ;
+    int j ;
+    int flags ;
+    for (loc = 0 ; loc < iMemSize ; loc++)
+    { in = &pgm->iMem[loc] ;
+      ip = &tMem[loc] ;
+      ip->r = in->iarg1 ;
+      if ( opClass(in->iop) == opclRR )
+      { ip->s = in->iarg2 ;
+        ip->t = in->iarg3 ;
+        ip->d = 0 ;
+      }
+      else
+      { ip->s = in->iarg3 ;
+        ip->t = 0 ;
+        ip->d = in->iarg2 ;
+      }
+      switch ( in->iop )
+      { case opADD : ip->handler = &&do_add ; break ;
+        case opSUB : ip->handler = &&do_sub ; break ;
+        case opMUL : ip->handler = &&do_mul ; break ;
+        case opDIV : ip->handler = &&do_div ; break ;
+        case opLD :  ip->handler = &&do_ld ;  break ;
+        case opST :  ip->handler = &&do_st ;  break ;
+        case opLDA : ip->handler = &&do_lda ; break ;
+        case opLDC : ip->handler = &&do_ldc ; break ;
+        case opJLT : ip->handler = &&do_jlt ; break ;
+        case opJLE : ip->handler = &&do_jle ; break ;
+        case opJGT : ip->handler = &&do_jgt ; break ;
+        case opJGE : ip->handler = &&do_jge ; break ;
+        case opJEQ : ip->handler = &&do_jeq ; break ;
+        case opJNE : ip->handler = &&do_jne ; break ;
+        case opPUSH : ip->handler = &&do_push ; break ;
+        case opPOP : ip->handler = &&do_pop ; break ;
+        case opRET : ip->handler = &&do_ret ; break ;
+        case opCALL : ip->handler = &&do_call ; break ;
+        case opMCPY : ip->handler = &&do_mcpy ; break ;
+        case opMSET : ip->handler = &&do_mset ; break ;
+        case opVADD : ip->handler = &&do_vadd ; break ;
+        case opVMUL : ip->handler = &&do_vmul ; break ;
+        case opVSUM : ip->handler = &&do_vsum ; break ;
+        case opVMIN : ip->handler = &&do_vmin ; break ;
+        case opVMAX : ip->handler = &&do_vmax ; break ;
+        default :    ip->handler = &&do_step ; break ;
+      }
+      /* a write to the pc is a jump */
+      if ( (in->iarg1 == PC_REG) && (in->iop != opST)
+           && (in->iop < opJLT) )
+        ip->handler = (in->iop == opLDA) ? &&do_jmp : &&do_step ;
+      flags = tm_verify_flags (tm,loc) ;
+      /* a load into the pc stays on do_step */
+      if ( (flags & VERIFY_MEM) && (ip->handler == &&do_ld) )
+        ip->handler = &&do_ld_u ;
+      if ( (flags & VERIFY_MEM) && (ip->handler == &&do_st) )
+        ip->handler = &&do_st_u ;
+      if ( flags & VERIFY_JUMP )
+        ip->handler = (in->iop == opLDA) ? &&do_jmp_u
+                                         : jumpTabU[in->iop - opJLT] ;
+      if ( flags & VERIFY_CHECK )
+        ip->handler = (in->iop == opLD) ? &&do_ld_check : &&do_check ;
+    }
+    tMem[iMemSize].handler = &&imem_err ;
+    /* breakpoints trap before their instruction */
+    if ( pgm->brk != NULL )
+      for (loc = 0 ; loc < iMemSize ; loc++)
+        if ( pgm->brk->at[loc] ) tMem[loc].handler = &&do_brk ;
+    /* the copy for watchpoints: every ST checks
+     * them, and there are no superinstructions */
+    if ( tm->watch != NULL )
+    { TMWatch * watch = tm->watch ;
+      ip = (THREADEDINSTR *) realloc(watch->tMem,
+                                     (iMemSize + 1) * sizeof(THREADEDINSTR)) ;
+      if ( ip == NULL ) tm_watch_free (tm) ;
+      else
+      { watch->tMem = ip ;
+        memcpy(ip,tMem,(iMemSize + 1) * sizeof(THREADEDINSTR)) ;
+        for (loc = 0 ; loc < iMemSize ; loc++)
+          if ( ip[loc].handler != &&do_brk )
+          { if ( pgm->iMem[loc].iop == opST ) ip[loc].handler = &&do_st_w ;
+            if ( (pgm->iMem[loc].iop == opPUSH)
+                 || (pgm->iMem[loc].iop == opCALL)
+                 || (pgm->iMem[loc].iop == opMCPY)
+                 || (pgm->iMem[loc].iop == opMSET)
+                 || (pgm->iMem[loc].iop == opVADD)
+                 || (pgm->iMem[loc].iop == opVMUL) )
+              ip[loc].handler = &&do_step ;
+          }
+      }
+    }
+    if ( ! FUSE_THREADED ) return srOKAY ;
+
+    for (loc = 0 ; loc + 4 < pgm->iSize ; loc++)
+    { in = &pgm->iMem[loc] ;
+      if ( (tMem[loc].handler == &&do_sub)
+           && (tMem[loc+1].handler != &&do_brk)
+           && (tMem[loc+2].handler != &&do_brk)
+           && (tMem[loc+3].handler != &&do_brk)
+           && (tMem[loc+4].handler != &&do_brk)
+           && (in[1].iop >= opJLT) && (in[1].iop <= opJNE)
+           && (in[1].iarg1 == in->iarg1) && (in[1].iarg2 == 2)
+           && (in[1].iarg3 == PC_REG)
+           && (in[2].iop == opLDC) && (in[2].iarg1 == in->iarg1)
+           && (in[2].iarg2 == 0)
+           && (in[3].iop == opLDA) && (in[3].iarg1 == PC_REG)
+           && (in[3].iarg2 == 1) && (in[3].iarg3 == PC_REG)
+           && (in[4].iop == opLDC) && (in[4].iarg1 == in->iarg1)
+           && (in[4].iarg2 == 1) )
+        tMem[loc].handler = compareTab[in[1].iop - opJLT] ;
+    }
+    for (loc = 0 ; loc + 3 < pgm->iSize ; loc++)
+    { in = &pgm->iMem[loc] ;
+      if ( (tMem[loc].handler == &&do_sub)
+           && (in->iarg3 == in->iarg1) && (in->iarg2 != in->iarg1)
+           && (tMem[loc+1].handler == &&do_ldc)
+           && (in[1].iarg1 == in->iarg2) && (in[1].iarg2 == 1)
+           && (tMem[loc+2].handler != &&do_brk)
+           && (in[2].iop >= opJLT) && (in[2].iop <= opJNE)
+           && (in[2].iarg1 == in->iarg1) && (in[2].iarg2 == 1)
+           && (in[2].iarg3 == PC_REG)
+           && (tMem[loc+3].handler == &&do_ldc)
+           && (in[3].iarg1 == in->iarg2) && (in[3].iarg2 == 0) )
+        tMem[loc].handler = valueTab[in[2].iop - opJLT] ;
+    }
+    for (loc = 0 ; loc + 1 < pgm->iSize ; loc++)
+    { in = &pgm->iMem[loc] ;
+      if ( (tMem[loc].handler == &&do_sub)
+           && (in[1].iop >= opJLT) && (in[1].iop <= opJNE)
+           && (in[1].iarg1 == in->iarg1) )
+      { j = in[1].iop - opJLT ;
+        if ( tMem[loc+1].handler == jumpTabU[j] )
+          tMem[loc++].handler = branchTab[1][j] ;
+        else if ( tMem[loc+1].handler == jumpTab[j] )
+          tMem[loc++].handler = branchTab[0][j] ;
+      }
+    }
+    /* pair from the left, so that a run such as
+     * ST LD LD ADD becomes ST+LD and LD+ADD; a
+     * pair is unchecked only if both halves are */
+#define CHECKED(h) ( (h) == &&do_ld_u ? &&do_ld : \
+                     (h) == &&do_st_u ? &&do_st : (h) )
+    for (loc = 0 ; loc + 1 < pgm->iSize ; loc++)
+    { h0 = tMem[loc].handler ;
+      h1 = tMem[loc+1].handler ;
+      for (p = 0 ; p < sizeof(pairTab) / sizeof(pairTab[0]) ; p++)
+        if ( (CHECKED(h0) == pairTab[p][0])
+             && (CHECKED(h1) == pairTab[p][1]) )
+        { if ( (h0 == &&do_ld) || (h0 == &&do_st)
+               || (h1 == &&do_ld) || (h1 == &&do_st) )
+            tMem[loc++].handler = pairTab[p][2] ;
+          else
+            tMem[loc++].handler = pairTabU[p] ;
+          break ;
+        }
+    }
+#undef CHECKED
+    return srOKAY ;
+  }
+
+  if ( tm->watch != NULL ) tMem = tm->watch->tMem ;
+  JUMP(reg[PC_REG]) ;
+
+do_step :
+  /* rare instructions: let tm_step do the work */
+  reg[PC_REG] = pc ;
+  result = tm_step (tm) ;
+  if ( result != srOKAY ) goto done ;
+  JUMP(reg[PC_REG]) ;
+
+do_check :
+  /* a jump the verifier did not follow */
+  reg[PC_REG] = pc ;
+  result = tm_step (tm) ;
+  if ( (result != srOKAY) || ! tm_verify_entry (tm) ) goto done ;
+  JUMP(reg[PC_REG]) ;
+do_ld_check :
+  /* the same for a return, LD pc, with the test
+   * of tm_verify_entry inline: runThreaded runs
+   * only when it held at the start */
+  OP_LD
+  m = reg[PC_REG] ;
+  if ( (m >= 0) && (m < verify->size) )
+  { st = &verify->in[m] ;
+    v = st->reached && VERIFY_IN(dMem[0],st->mem0) ;
+    for (loc = 0 ; loc < PC_REG ; loc++)
+      v &= VERIFY_IN(reg[loc],st->reg[loc]) ;
+    result = srOKAY ;
+    if ( ! v ) goto done ;
+  }
+  JUMP(reg[PC_REG]) ;
+
+do_add :  OP_ADD  NEXT() ;
+do_sub :  OP_SUB  NEXT() ;
+do_mul :  OP_MUL  NEXT() ;
+do_div :
+  if ( reg[ip->t] == 0 )
+  { result = srZERODIVIDE ;
+    goto done ;
+  }
+  reg[ip->r] = divide(reg[ip->s],reg[ip->t]) ;
+  NEXT() ;
+
+do_ld :   OP_LD  NEXT() ;
+do_st :   OP_ST  NEXT() ;
+
+do_lda :  OP_LDA  NEXT() ;
+do_ldc :  OP_LDC  NEXT() ;
+do_jmp :  JUMP(ip->d + reg[ip->s]) ;
+do_jlt :  if ( reg[ip->r] <  0 ) JUMP(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jle :  if ( reg[ip->r] <= 0 ) JUMP(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jgt :  if ( reg[ip->r] >  0 ) JUMP(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jge :  if ( reg[ip->r] >= 0 ) JUMP(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jeq :  if ( reg[ip->r] == 0 ) JUMP(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jne :  if ( reg[ip->r] != 0 ) JUMP(ip->d + reg[ip->s]) ;  NEXT() ;
+
+do_push :
+  m = reg[ip->s] ;
+  if ( (m < 0) || (m >= dSize) ) goto dmem_err ;
+  dMem[m] = reg[ip->r] ;
+  reg[ip->s] = m - 1 ;
+  NEXT() ;
+do_pop :
+  m = reg[ip->s] + 1 ;
+  if ( (m < 0) || (m >= dSize) ) goto dmem_err ;
+  reg[ip->s] = m ;
+  reg[ip->r] = dMem[m] ;
+  NEXT() ;
+do_ret :
+  m = reg[ip->s] + 1 ;
+  if ( (m < 0) || (m >= dSize) ) goto dmem_err ;
+  reg[ip->s] = m ;
+  JUMP(dMem[m]) ;
+do_call :
+  v = ip->d + reg[ip->s] ;
+  m = reg[ip->r] ;
+  if ( (m < 0) || (m >= dSize) ) goto dmem_err ;
+  dMem[m] = pc + 1 ;
+  reg[ip->r] = m - 1 ;
+  JUMP(v) ;
+do_mcpy :
+  m = reg[ip->t] ;
+  if ( ! inBlock(reg[ip->r],m,dSize) || ! inBlock(reg[ip->s],m,dSize) )
+    goto dmem_err ;
+  memmove(dMem + reg[ip->r],dMem + reg[ip->s],m * sizeof(int)) ;
+  NEXT() ;
+do_mset :
+  m = reg[ip->t] ;
+  if ( ! inBlock(reg[ip->r],m,dSize) ) goto dmem_err ;
+  for (v = reg[ip->r] ; m > 0 ; m--) dMem[v++] = reg[ip->s] ;
+  NEXT() ;
+do_vadd :
+  m = reg[ip->t] ;
+  if ( ! inBlock(reg[ip->r],m,dSize) || ! inBlock(reg[ip->s],m,dSize) )
+    goto dmem_err ;
+  vecAdd(dMem + reg[ip->r],dMem + reg[ip->s],m) ;
+  NEXT() ;
+do_vmul :
+  m = reg[ip->t] ;
+  if ( ! inBlock(reg[ip->r],m,dSize) || ! inBlock(reg[ip->s],m,dSize) )
+    goto dmem_err ;
+  vecMul(dMem + reg[ip->r],dMem + reg[ip->s],m) ;
+  NEXT() ;
+do_vsum :
+  m = reg[ip->t] ;
+  if ( ! inBlock(reg[ip->s],m,dSize) ) goto dmem_err ;
+  reg[ip->r] = vecSum(dMem + reg[ip->s],m) ;
+  NEXT() ;
+do_vmin :
+  m = reg[ip->t] ;
+  if ( ! inBlock(reg[ip->s],m,dSize) ) goto dmem_err ;
+  reg[ip->r] = vecBest(dMem + reg[ip->s],m,reg[ip->r],FALSE) ;
+  NEXT() ;
+do_vmax :
+  m = reg[ip->t] ;
+  if ( ! inBlock(reg[ip->s],m,dSize) ) goto dmem_err ;
+  reg[ip->r] = vecBest(dMem + reg[ip->s],m,reg[ip->r],TRUE) ;
+  NEXT() ;
+
+  /* verified: no address check */
+do_ld_u :   OP_LDU  NEXT() ;
+do_st_u :   OP_STU  NEXT() ;
+do_jmp_u :  JUMPU(ip->d + reg[ip->s]) ;
+do_jlt_u :  if ( reg[ip->r] <  0 ) JUMPU(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jle_u :  if ( reg[ip->r] <= 0 ) JUMPU(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jgt_u :  if ( reg[ip->r] >  0 ) JUMPU(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jge_u :  if ( reg[ip->r] >= 0 ) JUMPU(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jeq_u :  if ( reg[ip->r] == 0 ) JUMPU(ip->d + reg[ip->s]) ;  NEXT() ;
+do_jne_u :  if ( reg[ip->r] != 0 ) JUMPU(ip->d + reg[ip->s]) ;  NEXT() ;
+
+  /* superinstructions */
+do_st_ld :   OP_ST   INTO(do_ld) ;
+do_st_ldc :  OP_ST   INTO(do_ldc) ;
+do_st_lda :  OP_ST   INTO(do_lda) ;
+do_ld_st :   OP_LD   INTO(do_st) ;
+do_ld_ld :   OP_LD   INTO(do_ld) ;
+do_ld_add :  OP_LD   INTO(do_add) ;
+do_ld_sub :  OP_LD   INTO(do_sub) ;
+do_ld_mul :  OP_LD   INTO(do_mul) ;
+do_ld_div :  OP_LD   INTO(do_div) ;
+do_ldc_ld :  OP_LDC  INTO(do_ld) ;
+do_ldc_st :  OP_LDC  INTO(do_st) ;
+do_lda_st :  OP_LDA  INTO(do_st) ;
+do_add_st :  OP_ADD  INTO(do_st) ;
+do_sub_st :  OP_SUB  INTO(do_st) ;
+do_mul_st :  OP_MUL  INTO(do_st) ;
+do_div_st :
+  if ( reg[ip->t] == 0 )
+  { result = srZERODIVIDE ;
+    goto done ;
+  }
+  reg[ip->r] = divide(reg[ip->s],reg[ip->t]) ;
+  INTO(do_st) ;
+
+do_st_ld_u :   OP_STU  INTO(do_ld_u) ;
+do_st_ldc_u :  OP_STU  INTO(do_ldc) ;
+do_st_lda_u :  OP_STU  INTO(do_lda) ;
+do_ld_st_u :   OP_LDU  INTO(do_st_u) ;
+do_ld_ld_u :   OP_LDU  INTO(do_ld_u) ;
+do_ld_add_u :  OP_LDU  INTO(do_add) ;
+do_ld_sub_u :  OP_LDU  INTO(do_sub) ;
+do_ld_mul_u :  OP_LDU  INTO(do_mul) ;
+do_ld_div_u :  OP_LDU  INTO(do_div) ;
+do_ldc_ld_u :  OP_LDC  INTO(do_ld_u) ;
+do_ldc_st_u :  OP_LDC  INTO(do_st_u) ;
+do_lda_st_u :  OP_LDA  INTO(do_st_u) ;
+do_add_st_u :  OP_ADD  INTO(do_st_u) ;
+do_sub_st_u :  OP_SUB  INTO(do_st_u) ;
+do_mul_st_u :  OP_MUL  INTO(do_st_u) ;
+do_div_st_u :
+  if ( reg[ip->t] == 0 )
+  { result = srZERODIVIDE ;
+    goto done ;
+  }
+  reg[ip->r] = divide(reg[ip->s],reg[ip->t]) ;
+  INTO(do_st_u) ;
+
+do_cmp_lt :  COMPARE(<)
+do_cmp_le :  COMPARE(<=)
+do_cmp_gt :  COMPARE(>)
+do_cmp_ge :  COMPARE(>=)
+do_cmp_eq :  COMPARE(==)
+do_cmp_ne :  COMPARE(!=)
+do_val_lt :  VALUE(<)
+do_val_le :  VALUE(<=)
+do_val_gt :  VALUE(>)
+do_val_ge :  VALUE(>=)
+do_val_eq :  VALUE(==)
+do_val_ne :  VALUE(!=)
+
+do_sub_jlt :  OP_SUB  INTO(do_jlt) ;
+do_sub_jle :  OP_SUB  INTO(do_jle) ;
+do_sub_jgt :  OP_SUB  INTO(do_jgt) ;
+do_sub_jge :  OP_SUB  INTO(do_jge) ;
+do_sub_jeq :  OP_SUB  INTO(do_jeq) ;
+do_sub_jne :  OP_SUB  INTO(do_jne) ;
+do_sub_jlt_u :  OP_SUB  INTO(do_jlt_u) ;
+do_sub_jle_u :  OP_SUB  INTO(do_jle_u) ;
+do_sub_jgt_u :  OP_SUB  INTO(do_jgt_u) ;
+do_sub_jge_u :  OP_SUB  INTO(do_jge_u) ;
+do_sub_jeq_u :  OP_SUB  INTO(do_jeq_u) ;
+do_sub_jne_u :  OP_SUB  INTO(do_jne_u) ;
+
+do_st_w :
+  m = ip->d + reg[ip->s] ;
+  if ( (m < 0) || (m >= dSize) ) goto dmem_err ;
+  if ( WATCHED(tm->watch->bits,m) )
+  { tm->watch->addr = m ;
+    tm->watch->old = dMem[m] ;
+    dMem[m] = reg[ip->r] ;
+    /* done: carry on after it */
+    result = srWATCH ;
+    goto done ;
+  }
+  dMem[m] = reg[ip->r] ;
+  NEXT() ;
+
+limit :
+  /* at a jump: the limits are looked at */
+  if ( ! tm_limit (tm,count) )
+  { next = tm->nextCheck ;
+    DISPATCH() ;
+  }
+  reg[PC_REG] = pc ;
+  result = srLIMIT ;
+  goto done ;
+
+do_brk :
+  /* not executed: tm_run carries on from here */
+  reg[PC_REG] = pc ;
+  count-- ;
+  result = srBREAK ;
+  goto done ;
+imem_err :
+  /* tm_step leaves the pc alone on this fault */
+  reg[PC_REG] = pc ;
+  result = srIMEM_ERR ;
+  goto done ;
+dmem_err :
+  result = srDMEM_ERR ;
+done :
+  tm->iloc = pc ;
+  tm->fused = fused ;
+  *icount = count ;
+  return result ;
+
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef JUMPU
+#undef INTO
+#undef OP_ADD
+#undef OP_SUB
+#undef OP_MUL
+#undef OP_LD
+#undef OP_ST
+#undef OP_LDU
+#undef OP_STU
+#undef OP_LDA
+#undef OP_LDC
+#undef COMPARE
+#undef VALUE
+} /* runThreaded */
+#endif
+
+/********************************************/
+/* now gives the wall-clock time in seconds */
+static double now (void)
+{ struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+} /* now */
+
+/********************************************/
+/* nextCheck gives the count at which a run at
+ * count next looks at its limits
+ */
+static int nextCheck (TMState * tm, int count)
+{ int next = INT_MAX;
+  if ( (tm->maxSeconds > 0) && (count < INT_MAX - LIMIT_STEPS) )
+    next = count + LIMIT_STEPS;
+  if ( (tm->maxSteps > 0) && (tm->maxSteps < next) )
+    next = tm->maxSteps;
+  return next;
+} /* nextCheck */
+
+/********************************************/
+void tm_limit_start (TMState * tm)
+{ if (tm->maxSeconds > 0) tm->deadline = now() + tm->maxSeconds;
+  tm->nextCheck = nextCheck(tm,0);
+} /* tm_limit_start */
+
+/********************************************/
+int tm_limit (TMState * tm, int count)
+{ if ( (tm->maxSteps > 0) && (count >= tm->maxSteps) ) return TRUE;
+  if ( (tm->maxSeconds > 0) && (now() >= tm->deadline) ) return TRUE;
+  tm->nextCheck = nextCheck(tm,count);
+  return FALSE;
+} /* tm_limit */
+
+/********************************************/
+/* runEngine is tm_run, stopping at every
+ * breakpoint it reaches. The threaded and jit
+ * engines return srOKAY when a jump leaves the
+ * states the verifier covers: the run carries
+ * on with tm_step
+ */
+static STEPRESULT runEngine (TMState * tm, int * icount)
+{ STEPRESULT stepResult = srOKAY;
+  int stepcnt = 0, next;
+  TMBreak * brk = tm->pgm->brk;
+  ENGINE engine = tm->engine;
+  /* only tm_step keeps the profile, trace and history */
+  int stepOnly = (tm->prof != NULL) || (tm->trace != NULL)
+                 || (tm->rev != NULL) || ! tm_verify_entry(tm);
+  /* compiled code does not look at watchpoints */
+  if ( (engine == engJIT) && (tm->watch != NULL) ) engine = engTHREADED;
+  tm->fused = 0;
+#if HAVE_THREADED
+  if ( (engine == engTHREADED) && ! stepOnly )
+    stepResult = runThreaded (tm,&stepcnt);
+#endif
+#if HAVE_JIT
+  if ( (engine == engJIT) && ! stepOnly )
+    stepResult = tm_jit_run (tm,&stepcnt);
+#endif
+  next = tm->nextCheck;
+  while (stepResult == srOKAY)
+  { if ( (brk != NULL) && tm_break_at(tm,tm->reg[PC_REG]) )
+    { tm->iloc = tm->reg[PC_REG];
+      stepResult = srBREAK;
+      break;
+    }
+    if ( stepcnt >= next )
+    { if (tm_limit(tm,stepcnt))
+      { tm->iloc = tm->reg[PC_REG];
+        stepResult = srLIMIT;
+        break;
+      }
+      next = tm->nextCheck;
+    }
+    stepResult = tm_step (tm);
+    stepcnt++;
+  }
+  *icount = stepcnt;
+  return stepResult;
+} /* runEngine */
+
+/********************************************/
+STEPRESULT tm_run (TMState * tm, int * icount)
+{ STEPRESULT stepResult;
+  tm_limit_start(tm);
+  if (! tm_break_at(tm,tm->reg[PC_REG]))
+    return runEngine (tm,icount);
+  /* leaving a breakpoint: its instruction first */
+  stepResult = tm_step (tm);
+  *icount = 1;
+  if (stepResult != srOKAY) return stepResult;
+  stepResult = runEngine (tm,icount);
+  (*icount)++;
+  return stepResult;
+} /* tm_run */
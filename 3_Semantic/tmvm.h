@@ -0,0 +1,348 @@
+/****************************************************/
+/* File: tmvm.h                                     */
+/* The TM ("Tiny Machine") virtual machine library: */
+/* all simulator state lives in a TMState, so any   */
+/* number of machines can run in one process        */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TMVM_H_
+#define _TMVM_H_
+
+#include <stdio.h>
+#include "tm.h"
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+/******* const *******/
+/* default memory sizes: tm_set_memory changes
+ * them, and iMem grows to fit the program */
+#define   IADDR_SIZE  1024
+#define   DADDR_SIZE  1024
+#define   MAX_IADDR_SIZE  (1 << 24) /* largest iMem */
+#define   NO_REGS 8
+#define   PC_REG  7
+
+#define   LINESIZE  121
+#define   WORDSIZE  20
+
+/******* type  *******/
+
+typedef enum {
+   opclRR,     /* reg operands r,s,t */
+   opclRM,     /* reg r, mem d+s */
+   opclRA      /* reg r, int d+s */
+   } OPCLASS;
+
+typedef enum {
+   srOKAY,
+   srHALT,
+   srIMEM_ERR,
+   srDMEM_ERR,
+   srZERODIVIDE,
+   srNO_INPUT,
+   srBREAK,     /* at a breakpoint, see tmbreak.h */
+   srWATCH,     /* wrote a watched word */
+   srLIMIT      /* over maxSteps or maxSeconds */
+   } STEPRESULT;
+
+typedef struct {
+      int iop  ;
+      int iarg1  ;
+      int iarg2  ;
+      int iarg3  ;
+   } INSTRUCTION;
+
+typedef enum {
+   engSWITCH,   /* tm_step once per instruction */
+   engTHREADED, /* predecoded threaded code (computed goto) */
+   engJIT       /* hot blocks compiled to x86-64 code */
+   } ENGINE;
+
+/* predecoded form of an iMem location for the
+ * threaded engine: handler is the address of the
+ * code executing the instruction, so dispatch is a
+ * single indirect jump with no opClass() or switch.
+ * s is the base register of RM and RA instructions.
+ * The registers share a word with d, so that four
+ * locations fit in a cache line rather than 2.67.
+ */
+typedef struct {
+      void * handler ;
+      int d ;
+      unsigned char r, s, t ;
+   } THREADEDINSTR;
+
+/* the threaded engine relies on the GNU C "labels as
+ * values" extension; other compilers get tm_step only
+ */
+#ifdef __GNUC__
+#define HAVE_THREADED TRUE
+#else
+#define HAVE_THREADED FALSE
+#endif
+
+/* the JIT engine generates x86-64 code */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_JIT TRUE
+#else
+#define HAVE_JIT FALSE
+#endif
+
+/* FUSE_THREADED = TRUE lets the threaded engine
+ * run common cgen sequences as superinstructions
+ */
+#ifndef FUSE_THREADED
+#define FUSE_THREADED TRUE
+#endif
+
+/* instructions between looks at the clock, with
+ * a time limit (tm_limit)
+ */
+#define LIMIT_STEPS (1 << 20)
+
+/* A loaded program: iMem, its predecoded form,
+ * what the verifier proved about it (tmverify.h)
+ * and its breakpoints (tmbreak.h). Only setting
+ * breakpoints changes it after tm_load, so
+ * machines made by tm_share can use it at the
+ * same time.
+ */
+typedef struct {
+      INSTRUCTION * iMem ; /* iMemSize locations */
+      /* iMemSize+1 locations: the extra one catches
+       * execution falling off the end of iMem */
+      THREADEDINSTR * tMem ;
+      int iMemSize ; /* the instruction memory size */
+      int iSize ; /* number of locations loaded */
+      int refs ;  /* number of machines using it */
+      struct TMVerifyRec * verify ; /* see tmverify.c */
+      struct TMBreakRec * brk ; /* see tmbreak.c */
+   } TMProgram;
+
+/* The state of one machine. IN takes the next of
+ * the inCount values in inVals, or calls input if
+ * it is set; input returns FALSE when there is no
+ * value. OUT appends to outVals, or calls output
+ * if it is set. user is left for these routines.
+ */
+typedef struct TMStateRec
+   { TMProgram * pgm ;
+     int reg [NO_REGS] ;
+     int * dMem ; /* dSize locations, mapped so that
+                   * only pages in use take memory */
+     int dSize ;
+     int iLimit ; /* iMem size for tm_load, at least */
+     ENGINE engine ;
+     int iloc ; /* location of the last instruction executed */
+     int fused ; /* dispatches saved by superinstructions
+                  * in the last tm_run */
+     int * inVals ;
+     int inCount ;
+     int inPos ;
+     int (* input) (struct TMStateRec * tm, int * value) ;
+     int * outVals ;
+     int outCount ;
+     int outCap ;
+     void (* output) (struct TMStateRec * tm, int value) ;
+     void * user ;
+     struct TMJitRec * jit ; /* compiled code, see tmjit.c */
+     int jitCheck ; /* check the JIT against tm_step */
+     struct TMProfileRec * prof ; /* counts, see tmprof.c */
+     struct TMTraceRec * trace ; /* records, see tmtrace.c */
+     struct TMRevRec * rev ; /* history, see tmrev.c */
+     struct TMWatchRec * watch ; /* see tmbreak.c */
+     int maxSteps ;      /* limits of tm_run, 0 for none */
+     double maxSeconds ; /* (wall-clock time) */
+     int nextCheck ;     /* count at which to call tm_limit */
+     double deadline ;
+   } TMState;
+
+/* A saved machine state (tm_snapshot): the
+ * registers, the data memory pages in use, the
+ * input position and output so far, and the
+ * program, which is shared rather than copied
+ */
+typedef struct {
+      TMProgram * pgm ;
+      int reg [NO_REGS] ;
+      int dSize ;
+      int iloc ;
+      int inPos ;
+      int * outVals ;
+      int outCount ;
+      int npages ;
+      size_t * pageNo ; /* which pages of dMem */
+      char * pages ;    /* their contents */
+   } TMSnapshot;
+
+/* A line of text being scanned by tm_get_num and
+ * tm_get_word (program lines and user commands)
+ */
+typedef struct {
+      char text [LINESIZE] ;
+      int len ;
+      int col ;
+      char ch ;
+      int num ;           /* value from tm_get_num */
+      char word [WORDSIZE] ; /* text from tm_get_word */
+   } TMLine;
+
+extern char * opCodeTab[];
+extern char * stepResultTab[];
+extern char * engineTab[];
+
+/* Function tm_create returns a new machine with
+ * no program and memories of the default sizes,
+ * or NULL if out of memory
+ */
+TMState * tm_create (void);
+
+/* Function tm_set_memory sets the size of data
+ * memory, clearing it, and the smallest size of
+ * instruction memory for the next tm_load.
+ * FALSE if the data memory cannot be mapped.
+ */
+int tm_set_memory (TMState * tm, int iLimit, int dSize);
+
+/* Function tm_share returns a new, reset machine
+ * running the program of tm, which it shares
+ * rather than copies; NULL if out of memory.
+ * Not thread safe: share before starting threads.
+ */
+TMState * tm_share (TMState * tm);
+
+/* Procedure tm_destroy frees tm, and its program
+ * when no other machine shares it
+ */
+void tm_destroy (TMState * tm);
+
+/* Procedure tm_decode predecodes the program of
+ * tm again for the threaded engine, as when its
+ * breakpoints change
+ */
+void tm_decode (TMState * tm);
+
+/* Function tm_load reads a text (.tm) or binary
+ * (.tmb) program file into tm and resets it.
+ * Errors are reported on stderr and give FALSE.
+ */
+int tm_load (TMState * tm, char * name);
+
+/* Function tm_is_object tells whether a file
+ * name is that of a binary (.tmb) program
+ */
+int tm_is_object (char * name);
+
+/* Procedure tm_reset clears registers, data memory,
+ * input position and collected output, ready to
+ * run the program again
+ */
+void tm_reset (TMState * tm);
+
+/* Function tm_step executes one instruction */
+STEPRESULT tm_step (TMState * tm);
+
+/* Function tm_run executes with tm->engine until
+ * the result is not srOKAY; *icount receives the
+ * number of instructions, including the last one
+ * (an instruction at a breakpoint it stops at
+ * has not run). It stops with srLIMIT, the pc at
+ * the next instruction, when over tm->maxSteps
+ * instructions or tm->maxSeconds (see
+ * tm_limit). With watchpoints the JIT engine
+ * is replaced by the threaded one.
+ * While profiling (tmprof.h), tracing
+ * (tmtrace.h) or recording the history
+ * (tmrev.h) it uses tm_step, as it does when
+ * the state is not one the verifier allowed for
+ * (tmverify.h), e.g. after registers are set by
+ * hand: the other engines leave out the checks
+ * the verifier proved needless.
+ */
+STEPRESULT tm_run (TMState * tm, int * icount);
+
+/* Procedure tm_limit_start starts a run under
+ * the limits of tm, as tm_run does
+ */
+void tm_limit_start (TMState * tm);
+
+/* Function tm_limit tells whether a run that
+ * has executed count instructions is over the
+ * limits of tm; if not, it sets tm->nextCheck
+ * to the count at which to ask again. The
+ * engines only ask when they jump (the threaded
+ * engine) or go from block to block (the JIT),
+ * so a run may go on to the end of the basic
+ * block it is in; the clock is read once every
+ * LIMIT_STEPS instructions.
+ */
+int tm_limit (TMState * tm, int count);
+
+/* Function tm_snapshot saves the state of tm,
+ * or returns NULL when out of memory. Only the
+ * pages of dMem the machine has touched are kept.
+ */
+TMSnapshot * tm_snapshot (TMState * tm);
+
+/* Function tm_restore puts tm back in the state
+ * saved in snap, which may come from another
+ * machine; FALSE when out of memory. Machines
+ * sharing the program of snap may restore it at
+ * the same time.
+ */
+int tm_restore (TMState * tm, TMSnapshot * snap);
+
+/* Procedure tm_snapshot_free frees snap */
+void tm_snapshot_free (TMSnapshot * snap);
+
+/* Procedure tm_set_input makes IN read the n
+ * values at vals (not copied) from the first one
+ */
+void tm_set_input (TMState * tm, int * vals, int n);
+
+/* Functions tm_write_text and tm_write_object save
+ * the program in the text or binary (.tmb) form
+ */
+int tm_write_text (TMState * tm, FILE * out);
+int tm_write_object (TMState * tm, FILE * out);
+
+/* Function tm_write_c writes a C program that runs
+ * the program of tm the way "tm -b" would, using
+ * name in its heading (tm2c.c)
+ */
+int tm_write_c (TMState * tm, FILE * out, char * name);
+
+/* Procedure tm_write_instruction prints iMem[loc]
+ * the way the trace and the i(Mem command show it
+ */
+void tm_write_instruction (TMState * tm, FILE * out, int loc);
+
+/* Procedure tm_print_instruction prints in, found
+ * at loc, the same way but without a newline
+ */
+void tm_print_instruction (FILE * out, int loc, INSTRUCTION * in);
+
+/* Function opClass gives the class of opcode c */
+int opClass (int c);
+
+/* Function tm_stack_reg gives the stack pointer
+ * of a PUSH, POP, RET or CALL, or -1 for other
+ * instructions
+ */
+int tm_stack_reg (INSTRUCTION * in);
+
+/* line scanning for program text and commands */
+void tm_set_line (TMLine * l, char * text);
+int tm_get_num (TMLine * l);
+int tm_get_word (TMLine * l);
+int tm_skip_ch (TMLine * l, char c);
+int tm_at_eol (TMLine * l);
+
+#endif
@@ -217,6 +217,13 @@ void printTree( TreeNode * tree )
         case RetK:
           fprintf(listing,"Return :\n");
           break;
+        case VecK:
+          { static char * vecName[] =
+              { "copy","fill","add","mul","sum","min","max" };
+            fprintf(listing,"Vector loop %s : (condition) (array) (operands)\n",
+                    vecName[tree->attr.vec]);
+          }
+          break;
         default:
           fprintf(listing,"Unknown ExpNode kind\n");
           break;
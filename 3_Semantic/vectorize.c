@@ -0,0 +1,240 @@
+/****************************************************/
+/* File: vectorize.c                                */
+/* Loop vectorization for the C-MINUS compiler:     */
+/* while loops over arrays become VecK nodes, for   */
+/* the TM block and vector instructions             */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include "globals.h"
+#include "vectorize.h"
+
+/* A loop is vectorized when it has the form
+ *
+ *   while (i < n) { s; i = i + 1; }
+ *
+ * where i is an int variable, n is made of
+ * constants, operators and int variables that s
+ * does not assign, and s is one of
+ *
+ *   a[i] = b[i];                         VecCopyK
+ *   a[i] = e;          (e made like n)   VecFillK
+ *   a[i] = a[i] + b[i];                  VecAddK
+ *   a[i] = a[i] * b[i];                  VecMulK
+ *   x = x + a[i];                        VecSumK
+ *   if (a[i] < x) { x = a[i]; k = i; }   VecMinK
+ *   if (a[i] > x) { x = a[i]; k = i; }   VecMaxK
+ *
+ * with the operands of + and * either way round,
+ * and k = i left out or in either order. The
+ * comparison tests the wrapped difference a[i] - x,
+ * as VMIN and VMAX do; x - a[i] is not its
+ * negation for the least int, so x > a[i] and
+ * x < a[i] are left as loops. The VecK node has
+ * the condition as child[0], a[i] as child[1],
+ * and b[i], e, x, or x with k as its sibling, as
+ * child[2]. It does what the loop did: nothing
+ * unless i < n, else the instruction on the n-i
+ * words from a[i] (and b[i]), leaving i equal to
+ * n. Two C-Minus arrays are either the same or
+ * apart, so the order in which the words are
+ * done does not matter. One thing differs: if
+ * the words run out of mem the instruction
+ * faults before it writes any, where the loop
+ * wrote those up to the first out of mem.
+ */
+
+/* the variables the loop assigns */
+#define MAXWRITTEN 3
+
+/* isId tells whether t is the int variable name,
+ * or any int variable if name is NULL
+ */
+static int isId(TreeNode * t, char * name)
+{ return (t != NULL) && (t->nodekind == ExpK) && (t->kind.exp == IdK)
+         && (t->type == Integer)
+         && ((name == NULL) || (strcmp(t->attr.name,name) == 0));
+}
+
+/* isElem tells whether t is a[i] for an array a
+ * and the variable index as i
+ */
+static int isElem(TreeNode * t, char * index)
+{ return (t != NULL) && (t->nodekind == ExpK) && (t->kind.exp == IdArrK)
+         && isId(t->child[0],index);
+}
+
+static int isConst(TreeNode * t, int val)
+{ return (t != NULL) && (t->nodekind == ExpK) && (t->kind.exp == ConstK)
+         && (t->attr.val == val);
+}
+
+static int isOp(TreeNode * t, ExpKind kind, TokenType op)
+{ return (t != NULL) && (t->nodekind == ExpK) && (t->kind.exp == kind)
+         && (t->attr.op == op);
+}
+
+static int isAssign(TreeNode * t)
+{ return (t != NULL) && (t->nodekind == ExpK) && (t->kind.exp == AssignK);
+}
+
+static int sameName(TreeNode * s, TreeNode * t)
+{ return strcmp(s->attr.name,t->attr.name) == 0;
+}
+
+/* invariant tells whether e is made of constants,
+ * operators and int variables other than the n
+ * in written
+ */
+static int invariant(TreeNode * e, char * written[], int n)
+{ int k;
+  if ((e == NULL) || (e->nodekind != ExpK)) return FALSE;
+  switch (e->kind.exp)
+  { case ConstK:
+      return TRUE;
+    case IdK:
+      if (e->type != Integer) return FALSE;
+      for (k = 0; k < n; k++)
+        if (strcmp(e->attr.name,written[k]) == 0) return FALSE;
+      return TRUE;
+    case OpK:
+      return invariant(e->child[0],written,n)
+             && invariant(e->child[1],written,n);
+    default:
+      return FALSE;
+  }
+}
+
+/* statements puts the statements of body in
+ * stmt; FALSE unless there are from 1 to n of
+ * them and no declarations. It gives the number
+ * in *count.
+ */
+static int statements(TreeNode * body, TreeNode * stmt[], int n, int * count)
+{ if (body == NULL) return FALSE;
+  if ((body->nodekind == StmtK) && (body->kind.stmt == CompK))
+  { if (body->child[0] != NULL) return FALSE;
+    body = body->child[1];
+  }
+  for (*count = 0; body != NULL; body = body->sibling)
+  { if (*count == n) return FALSE;
+    stmt[(*count)++] = body;
+  }
+  return *count > 0;
+}
+
+/* isStep tells whether t is i = i + 1 */
+static int isStep(TreeNode * t, char * i)
+{ TreeNode * e;
+  if (!isAssign(t) || !isId(t->child[0],i)) return FALSE;
+  e = t->child[1];
+  return isOp(e,OpK,PLUS)
+         && ( (isId(e->child[0],i) && isConst(e->child[1],1))
+              || (isConst(e->child[0],1) && isId(e->child[1],i)) );
+}
+
+/* vecLoop makes the while loop t a VecK node if
+ * it has one of the forms above
+ */
+static void vecLoop(TreeNode * t)
+{ TreeNode * cond = t->child[0];
+  TreeNode * stmt[2], * s, * e, * a, * b, * x, * k = NULL;
+  char * i, * written[MAXWRITTEN];
+  int nwritten, count, n;
+  VecKind kind;
+
+  if (!isOp(cond,RelopK,LT) || !isId(cond->child[0],NULL)) return;
+  i = cond->child[0]->attr.name;
+  if (!statements(t->child[1],stmt,2,&count) || (count != 2)
+      || !isStep(stmt[1],i))
+    return;
+  s = stmt[0];
+  written[0] = i;
+  nwritten = 1;
+
+  if (isAssign(s) && isElem(s->child[0],i))
+  { /* a[i] = ... */
+    a = s->child[0];
+    e = s->child[1];
+    if (isElem(e,i))
+    { kind = VecCopyK;
+      b = e;
+    }
+    else if ((isOp(e,OpK,PLUS) || isOp(e,OpK,TIMES))
+             && isElem(e->child[0],i) && isElem(e->child[1],i)
+             && (sameName(a,e->child[0]) || sameName(a,e->child[1])))
+    { kind = (e->attr.op == PLUS) ? VecAddK : VecMulK;
+      b = sameName(a,e->child[0]) ? e->child[1] : e->child[0];
+    }
+    else if (invariant(e,written,nwritten))
+    { kind = VecFillK;
+      b = e;
+    }
+    else return;
+  }
+  else if (isAssign(s) && isId(s->child[0],NULL)
+           && isOp(s->child[1],OpK,PLUS))
+  { /* x = x + a[i] */
+    b = s->child[0];
+    e = s->child[1];
+    if (isId(e->child[0],b->attr.name) && isElem(e->child[1],i))
+      a = e->child[1];
+    else if (isElem(e->child[0],i) && isId(e->child[1],b->attr.name))
+      a = e->child[0];
+    else return;
+    kind = VecSumK;
+    written[nwritten++] = b->attr.name;
+  }
+  else if ((s->nodekind == StmtK) && (s->kind.stmt == SelK)
+           && (s->child[2] == NULL)
+           && (isOp(s->child[0],RelopK,LT) || isOp(s->child[0],RelopK,GT)))
+  { /* if (a[i] < x) { x = a[i]; k = i; } */
+    e = s->child[0];
+    if (isElem(e->child[0],i) && isId(e->child[1],NULL))
+    { a = e->child[0];
+      x = e->child[1];
+      kind = (e->attr.op == LT) ? VecMinK : VecMaxK;
+    }
+    else return;
+    if (!statements(s->child[1],stmt,2,&count)) return;
+    b = k = NULL;
+    for (n = 0; n < count; n++)
+      if (isAssign(stmt[n]) && isId(stmt[n]->child[0],x->attr.name)
+          && isElem(stmt[n]->child[1],i) && sameName(stmt[n]->child[1],a))
+        b = stmt[n]->child[0];
+      else if (isAssign(stmt[n]) && isId(stmt[n]->child[0],NULL)
+               && isId(stmt[n]->child[1],i))
+        k = stmt[n]->child[0];
+      else return;
+    if ((b == NULL) || ((k != NULL) && sameName(k,b))) return;
+    written[nwritten++] = b->attr.name;
+    if (k != NULL) written[nwritten++] = k->attr.name;
+  }
+  else return;
+
+  /* the loop must not assign n, nor i but by the step */
+  for (n = 1; n < nwritten; n++)
+    if (strcmp(written[n],i) == 0) return;
+  if (!invariant(cond->child[1],written,nwritten)) return;
+  t->kind.stmt = VecK;
+  t->attr.vec = kind;
+  t->child[1] = a;
+  t->child[2] = b;
+  if ((kind == VecMinK) || (kind == VecMaxK)) b->sibling = k;
+}
+
+/* Procedure vectorize turns the counted while
+ * loops over arrays of a type checked syntax tree
+ * that one TM block or vector instruction can do
+ * into VecK nodes
+ */
+void vectorize(TreeNode * t)
+{ int i;
+  for (; t != NULL; t = t->sibling)
+  { for (i = 0; i < MAXCHILDREN; i++)
+      vectorize(t->child[i]);
+    if ((t->nodekind == StmtK) && (t->kind.stmt == IterK))
+      vecLoop(t);
+  }
+}
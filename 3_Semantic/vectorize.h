@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: vectorize.h                                */
+/* Loop vectorization for the C-MINUS compiler      */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _VECTORIZE_H_
+#define _VECTORIZE_H_
+
+/* Procedure vectorize turns the counted while
+ * loops over arrays of a type checked syntax tree
+ * that one TM block or vector instruction can do
+ * into VecK nodes
+ */
+void vectorize(TreeNode *);
+
+#endif